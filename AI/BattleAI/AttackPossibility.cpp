@@ -24,13 +24,15 @@ int AttackPossibility::attackValue() const
 	return damageDiff() + tacticImpact;
 }
 
-AttackPossibility AttackPossibility::evaluate(const BattleAttackInfo &AttackInfo, const HypotheticChangesToBattleState &state, BattleHex hex)
+AttackPossibility AttackPossibility::evaluate(const BattleAttackInfo &AttackInfo, const HypotheticBattle &state, BattleHex hex)
 {
 	auto attacker = AttackInfo.attacker;
 	auto enemy = AttackInfo.defender;
+	const auto attackerState = state.getStackState(attacker);
+	const auto enemyState = state.getStackState(enemy);
 
-	const int remainingCounterAttacks = getValOr(state.counterAttacksLeft, enemy, enemy->counterAttacksRemaining());
-	const bool counterAttacksBlocked = attacker->hasBonusOfType(Bonus::BLOCKS_RETALIATION) || enemy->hasBonusOfType(Bonus::NO_RETALIATION);
+	const int remainingCounterAttacks = enemyState.counterAttacks;
+	const bool counterAttacksBlocked = AttackInfo.attackerBonuses->hasBonusOfType(Bonus::BLOCKS_RETALIATION) || AttackInfo.defenderBonuses->hasBonusOfType(Bonus::NO_RETALIATION);
 	const int totalAttacks = 1 + AttackInfo.attackerBonuses->getBonuses(Selector::type(Bonus::ADDITIONAL_ATTACK), (Selector::effectRange (Bonus::NO_LIMIT).Or(Selector::effectRange(Bonus::ONLY_MELEE_FIGHT))))->totalValue();
 
 	AttackPossibility ap = {enemy, hex, AttackInfo, 0, 0, 0};
@@ -46,8 +48,8 @@ AttackPossibility AttackPossibility::evaluate(const BattleAttackInfo &AttackInfo
 		if(remainingCounterAttacks <= i || counterAttacksBlocked)
 			ap.damageReceived = 0;
 
-		curBai.attackerCount = attacker->count - attacker->countKilledByAttack(ap.damageReceived).first;
-		curBai.defenderCount = enemy->count - enemy->countKilledByAttack(ap.damageDealt).first;
+		curBai.attackerCount = attackerState.count - attackerState.countKilledByAttack(ap.damageReceived).first;
+		curBai.defenderCount = enemyState.count - enemyState.countKilledByAttack(ap.damageDealt).first;
 		if(!curBai.attackerCount)
 			break;
 		//TODO what about defender? should we break? but in pessimistic scenario defender might be alive
@@ -56,8 +58,8 @@ AttackPossibility AttackPossibility::evaluate(const BattleAttackInfo &AttackInfo
 	//TODO other damage related to attack (eg. fire shield and other abilities)
 
 	//Limit damages by total stack health
-	vstd::amin(ap.damageDealt, enemy->totalHealth());
-	vstd::amin(ap.damageReceived, attacker->totalHealth());
+	vstd::amin(ap.damageDealt, enemyState.totalHealth());
+	vstd::amin(ap.damageReceived, attackerState.totalHealth());
 
 	return ap;
 }
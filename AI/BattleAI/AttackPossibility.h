@@ -8,16 +8,7 @@
  *
  */
 #pragma once
-#include "../../lib/BattleState.h"
-#include "../../CCallback.h"
-#include "common.h"
-
-
-struct HypotheticChangesToBattleState
-{
-	std::map<const CStack *, const IBonusBearer *> bonusesOfStacks;
-	std::map<const CStack *, int> counterAttacksLeft;
-};
+#include "HypotheticBattle.h"
 
 class Priorities
 {
@@ -45,6 +36,6 @@ public:
 	int damageDiff() const;
 	int attackValue() const;
 
-	static AttackPossibility evaluate(const BattleAttackInfo &AttackInfo, const HypotheticChangesToBattleState &state, BattleHex hex);
+	static AttackPossibility evaluate(const BattleAttackInfo &AttackInfo, const HypotheticBattle &state, BattleHex hex);
 	static Priorities * priorities;
 };
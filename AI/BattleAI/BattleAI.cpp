@@ -9,15 +9,35 @@
 	 */
 #include "StdInc.h"
 #include "BattleAI.h"
-#include "StackWithBonuses.h"
 #include "EnemyInfo.h"
 #include "../../lib/spells/CSpellHandler.h"
+#include "../../lib/CConfigHandler.h"
+#include "../../lib/CThreadPool.h"
 
 #define LOGL(text) print(text)
 #define LOGFL(text, formattingEl) print(boost::str(boost::format(text) % formattingEl))
 
+static std::vector<AttackPossibility> bestAttacks(const PotentialTargets & targets, size_t branching)
+{
+	auto ret = targets.possibleAttacks;
+	boost::stable_sort(ret, [](const AttackPossibility & a, const AttackPossibility & b)
+	{
+		return a.attackValue() > b.attackValue();
+	});
+	if(ret.size() > branching)
+		ret.erase(ret.begin() + branching, ret.end());
+	return ret;
+}
+
+static boost::posix_time::ptime decisionDeadline()
+{
+	//when the time budget of decision is exceeded, the best choice found so far is used
+	const si64 budget = settings["server"]["battleAITimeBudget"].Float();
+	return boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(budget);
+}
+
 CBattleAI::CBattleAI(void)
-	: side(-1), wasWaitingForRealize(false), wasUnlockingGs(false)
+	: side(-1), lookaheadPlies(1), lookaheadBranching(1), wasWaitingForRealize(false), wasUnlockingGs(false)
 {
 }
 
@@ -40,6 +60,8 @@ void CBattleAI::init(std::shared_ptr<CBattleCallback> CB)
 	wasUnlockingGs = CB->unlockGsWhenWaiting;
 	CB->waitTillRealize = true;
 	CB->unlockGsWhenWaiting = false;
+	lookaheadPlies = std::max<int>(settings["server"]["battleAILookaheadPlies"].Float(), 1);
+	lookaheadBranching = std::max<int>(settings["server"]["battleAILookaheadBranching"].Float(), 1);
 }
 
 BattleAction CBattleAI::activeStack( const CStack * stack )
@@ -79,7 +101,7 @@ BattleAction CBattleAI::activeStack( const CStack * stack )
 		PotentialTargets targets(stack);
 		if(targets.possibleAttacks.size())
 		{
-			auto hlp = targets.bestAction();
+			auto hlp = chooseAttack(stack, targets);
 			if(hlp.attack.shooting)
 				return BattleAction::makeShotAttack(stack, hlp.enemy);
 			else
@@ -160,6 +182,68 @@ BattleAction CBattleAI::goTowards(const CStack * stack, BattleHex destination)
 	}
 }
 
+AttackPossibility CBattleAI::chooseAttack(const CStack * stack, const PotentialTargets & targets) const
+{
+	//greedy order, so that greedy choice is kept when there is no time to look further
+	auto candidates = bestAttacks(targets, lookaheadBranching);
+	if(candidates.size() == 1)
+		return candidates.front();
+
+	std::vector<const CStack *> queue;
+	cb->battleGetStackQueue(queue, lookaheadPlies);
+	if(queue.empty() || queue.front() != stack)
+		queue.insert(queue.begin(), stack);
+
+	const auto deadline = decisionDeadline();
+	const HypotheticBattle battle(cb);
+	AttackPossibility best = candidates.front();
+	int bestValue = std::numeric_limits<int>::min();
+	for(auto & candidate : candidates)
+	{
+		HypotheticBattle state = battle;
+		state.makeAttack(candidate);
+		const int value = lookahead(state, queue, 1, bestValue, std::numeric_limits<int>::max(), deadline);
+		if(bestValue != std::numeric_limits<int>::min() && boost::posix_time::microsec_clock::universal_time() > deadline)
+		{
+			LOGL("Out of time for looking ahead, keeping the best attack found so far.");
+			break;
+		}
+		if(value > bestValue)
+		{
+			bestValue = value;
+			best = candidate;
+		}
+	}
+	LOGFL("Best attack is on %s, worth %d after %d stack turns.", best.enemy->nodeName() % bestValue % queue.size());
+	return best;
+}
+
+int CBattleAI::lookahead(const HypotheticBattle & state, const std::vector<const CStack *> & queue, size_t ply, int alpha, int beta, boost::posix_time::ptime deadline) const
+{
+	if(ply >= queue.size() || state.battleIsFinished() || boost::posix_time::microsec_clock::universal_time() > deadline)
+		return state.evaluate(side);
+
+	const CStack * stack = queue[ply];
+	auto attacks = state.isAlive(stack) ? bestAttacks(PotentialTargets(stack, state), lookaheadBranching) : std::vector<AttackPossibility>();
+	if(attacks.empty()) //stack is dead or would only move, which doesn't change the value
+		return lookahead(state, queue, ply + 1, alpha, beta, deadline);
+
+	const bool ourStack = stack->attackerOwned == !side;
+	for(auto & attack : attacks)
+	{
+		HypotheticBattle next = state;
+		next.makeAttack(attack);
+		const int value = lookahead(next, queue, ply + 1, alpha, beta, deadline);
+		if(ourStack)
+			vstd::amax(alpha, value);
+		else
+			vstd::amin(beta, value);
+		if(alpha >= beta)
+			break;
+	}
+	return ourStack ? alpha : beta;
+}
+
 BattleAction CBattleAI::useCatapult(const CStack * stack)
 {
 	throw std::runtime_error("The method or operation is not implemented.");
@@ -217,14 +301,50 @@ void CBattleAI::attemptCastingSpell()
 	if(possibleCasts.empty())
 		return;
 
-	std::map<const CStack*, int> valueOfStack;
-	for(auto stack : cb->battleGetStacks())
+	const auto deadline = decisionDeadline();
+	CThreadPool & pool = CThreadPool::get();
+
+	std::vector<std::vector<const CStack *>> affectedStacks(possibleCasts.size());
+	pool.parallelFor(0, possibleCasts.size(), [&](size_t i)
+	{
+		const PossibleSpellcast & ps = possibleCasts[i];
+		affectedStacks[i] = ps.spell->getAffectedStacks(cb.get(), ECastingMode::HERO_CASTING, hero, hero->getSpellSchoolLevel(ps.spell), ps.dest);
+		boost::sort(affectedStacks[i]);
+	});
+
+	//same spell on the same stacks is worth the same, whatever the target hex is
+	std::map<std::pair<const CSpell *, std::vector<const CStack *>>, size_t> groupOfCast;
+	std::vector<size_t> castGroups(possibleCasts.size());
+	std::vector<size_t> representatives; //cast evaluated for each group
+	for(size_t i = 0; i < possibleCasts.size(); i++)
 	{
-		PotentialTargets pt(stack);
-		valueOfStack[stack] = pt.bestActionValue();
+		auto inserted = groupOfCast.insert(std::make_pair(std::make_pair(possibleCasts[i].spell, affectedStacks[i]), representatives.size()));
+		if(inserted.second)
+			representatives.push_back(i);
+		castGroups[i] = inserted.first->second;
 	}
+	LOGFL("%d of them are different.", representatives.size());
+
+	//evaluations run in parallel, each on its own copy of this snapshot; bonuses are copied too,
+	//otherwise every bonus query of the workers would wait for the global lock of bonus caches
+	HypotheticBattle battle(cb);
+	battle.snapshotBonuses();
+
+	std::set<const CStack *> stacksToValue;
+	for(size_t i : representatives)
+		if(spellType(possibleCasts[i].spell) == TIMED_EFFECT)
+			range::copy(affectedStacks[i], vstd::set_inserter(stacksToValue));
+	const std::vector<const CStack *> valuedStacks(stacksToValue.begin(), stacksToValue.end());
+	std::vector<int> values(valuedStacks.size());
+	pool.parallelFor(0, valuedStacks.size(), [&](size_t i)
+	{
+		values[i] = PotentialTargets(valuedStacks[i], battle).bestActionValue();
+	});
+	std::map<const CStack*, int> valueOfStack;
+	for(size_t i = 0; i < valuedStacks.size(); i++)
+		valueOfStack[valuedStacks[i]] = values[i];
 
-	auto evaluateSpellcast = [&] (const PossibleSpellcast &ps) -> int
+	auto evaluateSpellcast = [&] (const PossibleSpellcast &ps, const std::vector<const CStack *> & stacksAffected) -> int
 	{
 		const int skillLevel = hero->getSpellSchoolLevel(ps.spell);
 		const int spellPower = hero->getPrimSkillLevel(PrimarySkill::SPELL_POWER);
@@ -233,10 +353,9 @@ void CBattleAI::attemptCastingSpell()
 		case OFFENSIVE_SPELL:
 		{
 			int damageDealt = 0, damageReceived = 0;
-			auto stacksSuffering = ps.spell->getAffectedStacks(cb.get(), ECastingMode::HERO_CASTING, hero, skillLevel, ps.dest);
-			if(stacksSuffering.empty())
+			if(stacksAffected.empty())
 				return -1;
-			for(auto stack : stacksSuffering)
+			for(auto stack : stacksAffected)
 			{
 				const int dmg = ps.spell->calculateDamage(hero, stack, skillLevel, spellPower);
 				if(stack->owner == playerID)
@@ -246,32 +365,30 @@ void CBattleAI::attemptCastingSpell()
 			}
 			const int damageDiff = damageDealt - damageReceived * 10;
 			LOGFL("Casting %s on hex %d would deal { %d %d } damage points among %d stacks.",
-				  ps.spell->name % ps.dest % damageDealt % damageReceived % stacksSuffering.size());
+				  ps.spell->name % ps.dest % damageDealt % damageReceived % stacksAffected.size());
 			//TODO tactic effect too
 			return damageDiff;
 		}
 		case TIMED_EFFECT:
 		{
-			auto stacksAffected = ps.spell->getAffectedStacks(cb.get(), ECastingMode::HERO_CASTING, hero, skillLevel, ps.dest);
 			if(stacksAffected.empty())
 				return -1;
 			int totalGain = 0;
 			for(const CStack * sta : stacksAffected)
 			{
-				StackWithBonuses swb;
-				swb.stack = sta;
 				Bonus pseudoBonus;
 				pseudoBonus.sid = ps.spell->id;
 				pseudoBonus.val = skillLevel;
 				pseudoBonus.turnsRemain = 1; //TODO
-				CStack::stackEffectToFeature(swb.bonusesToAdd, pseudoBonus);
-				HypotheticChangesToBattleState state;
-				state.bonusesOfStacks[swb.stack] = &swb;
-				PotentialTargets pt(swb.stack, state);
+				std::vector<Bonus> effects;
+				CStack::stackEffectToFeature(effects, pseudoBonus);
+				HypotheticBattle state = battle;
+				state.addEffects(sta, effects);
+				PotentialTargets pt(sta, state);
 				auto newValue = pt.bestActionValue();
-				auto oldValue = valueOfStack[swb.stack];
+				auto oldValue = valueOfStack.at(sta);
 				auto gain = newValue - oldValue;
-				if(swb.stack->owner != playerID) //enemy
+				if(sta->owner != playerID) //enemy
 					gain = -gain;
 				LOGFL("Casting %s on %s would improve the stack by %d points (from %d to %d)",
 					  ps.spell->name % sta->nodeName() % (gain) % (oldValue) % (newValue));
@@ -287,8 +404,25 @@ void CBattleAI::attemptCastingSpell()
 		}
 	};
 
-	for(PossibleSpellcast & psc : possibleCasts)
-		psc.value = evaluateSpellcast(psc);
+	const int NOT_EVALUATED = std::numeric_limits<int>::min();
+	std::vector<int> groupValues(representatives.size(), NOT_EVALUATED);
+	pool.parallelFor(0, representatives.size(), [&](size_t group)
+	{
+		if(group && boost::posix_time::microsec_clock::universal_time() > deadline)
+			return;
+		const size_t i = representatives[group];
+		groupValues[group] = evaluateSpellcast(possibleCasts[i], affectedStacks[i]);
+	});
+
+	for(size_t i = 0; i < possibleCasts.size(); i++)
+		possibleCasts[i].value = groupValues[castGroups[i]];
+	const size_t evaluatedCount = boost::count_if(groupValues, [=](int value){ return value != NOT_EVALUATED; });
+	if(evaluatedCount < groupValues.size())
+	{
+		LOGFL("Out of time, only %d of %d different casts were evaluated.", evaluatedCount % groupValues.size());
+		vstd::erase_if(possibleCasts, [=](const PossibleSpellcast & ps){ return ps.value == NOT_EVALUATED; });
+	}
+
 	auto pscValue = [] (const PossibleSpellcast &ps) -> int
 	{
 		return ps.value;
@@ -359,7 +493,7 @@ std::vector<BattleHex> CBattleAI::getTargetsToConsider(const CSpell * spell, con
 int CBattleAI::distToNearestNeighbour(BattleHex hex, const ReachabilityInfo::TDistances &dists, BattleHex *chosenHex)
 {
 	int ret = 1000000;
-	for(BattleHex n : hex.neighbouringTiles())
+	for(BattleHex n : hex.neighbouringTilesView())
 	{
 		if(dists[n] >= 0 && dists[n] < ret)
 		{
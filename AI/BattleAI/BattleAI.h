@@ -56,6 +56,8 @@ class CBattleAI : public CBattleGameInterface
 {
 	int side;
 	std::shared_ptr<CBattleCallback> cb;
+	int lookaheadPlies; //turns of stacks considered, starting with the active one
+	size_t lookaheadBranching; //best attacks of acting stack considered in each turn
 
 	//Previous setting of cb
 	bool wasWaitingForRealize, wasUnlockingGs;
@@ -70,6 +72,9 @@ public:
 	BattleAction activeStack(const CStack * stack) override; //called when it's turn of that stack
 	BattleAction goTowards(const CStack * stack, BattleHex hex );
 
+	AttackPossibility chooseAttack(const CStack * stack, const PotentialTargets & targets) const; //best of possible attacks, judged by looking few stack turns ahead
+	int lookahead(const HypotheticBattle & state, const std::vector<const CStack *> & queue, size_t ply, int alpha, int beta, boost::posix_time::ptime deadline) const; //value of state for us if stacks act in queue order from ply on
+
 	boost::optional<BattleAction> considerFleeingOrSurrendering();
 
 	std::vector<BattleHex> getTargetsToConsider(const CSpell *spell, const ISpellCaster * caster) const;
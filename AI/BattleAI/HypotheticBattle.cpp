@@ -0,0 +1,300 @@
+/*
+ * HypotheticBattle.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+#include "HypotheticBattle.h"
+#include "AttackPossibility.h"
+#include "../../lib/CCreatureHandler.h"
+
+HypotheticBattle::StackState::StackState(const CStack * Stack)
+	: stack(Stack), position(Stack->position), count(Stack->count), firstHPleft(Stack->firstHPleft),
+	counterAttacks(Stack->counterAttacksRemaining()), shots(Stack->shots)
+{
+}
+
+bool HypotheticBattle::StackState::alive() const
+{
+	return count > 0;
+}
+
+ui32 HypotheticBattle::StackState::totalHealth() const
+{
+	return count ? (count - 1) * getBonusBearer()->MaxHealth() + firstHPleft : 0;
+}
+
+std::pair<int, int> HypotheticBattle::StackState::countKilledByAttack(int damageReceived) const
+{
+	const int maxHealth = getBonusBearer()->MaxHealth();
+	int killedCount = damageReceived / maxHealth;
+	const int damageFirst = damageReceived % maxHealth;
+	int newRemainingHP = firstHPleft - damageFirst;
+	if(newRemainingHP <= 0)
+	{
+		killedCount++;
+		newRemainingHP += maxHealth;
+	}
+	return std::make_pair(killedCount, newRemainingHP);
+}
+
+std::vector<BattleHex> HypotheticBattle::StackState::getHexes() const
+{
+	return CStack::getHexes(position, stack->doubleWide(), stack->attackerOwned);
+}
+
+const IBonusBearer * HypotheticBattle::StackState::getBonusBearer() const
+{
+	if(bonuses)
+		return bonuses.get();
+	return stack;
+}
+
+HypotheticBattle::HypotheticBattle()
+	: HypotheticBattle(getCbc())
+{
+}
+
+HypotheticBattle::HypotheticBattle(std::shared_ptr<CBattleCallback> CB)
+	: cb(CB), stacks(CB->battleGetStacks()), positionsChanged(false)
+{
+}
+
+void HypotheticBattle::snapshotBonuses()
+{
+	assert(changedStacks.empty());
+	auto snapshots = std::make_shared<std::map<const CStack *, std::shared_ptr<const StackWithBonuses>>>();
+	for(auto stack : stacks)
+	{
+		auto bonuses = std::make_shared<StackWithBonuses>();
+		bonuses->stack = stack;
+		bonuses->snapshot = stack->getAllBonuses(Selector::all, nullptr);
+		(*snapshots)[stack] = bonuses;
+	}
+	bonusSnapshots = snapshots;
+}
+
+HypotheticBattle::StackState HypotheticBattle::getStackState(const CStack * stack) const
+{
+	auto it = changedStacks.find(stack);
+	if(it != changedStacks.end())
+		return *it->second;
+	return initialState(stack);
+}
+
+bool HypotheticBattle::isAlive(const CStack * stack) const
+{
+	auto it = changedStacks.find(stack);
+	if(it != changedStacks.end())
+		return it->second->alive();
+	return stack->alive();
+}
+
+std::vector<const CStack *> HypotheticBattle::battleAliveStacks() const
+{
+	std::vector<const CStack *> ret;
+	vstd::copy_if(stacks, std::back_inserter(ret), [this](const CStack * s){ return isAlive(s); });
+	return ret;
+}
+
+const CStack * HypotheticBattle::battleGetStackByPos(BattleHex pos) const
+{
+	for(auto stack : stacks)
+	{
+		auto state = getStackState(stack);
+		if(state.alive() && vstd::contains(state.getHexes(), pos))
+			return stack;
+	}
+	return nullptr;
+}
+
+boost::optional<int> HypotheticBattle::battleIsFinished() const
+{
+	bool hasStacks[2] = {false, false};
+	for(auto stack : battleAliveStacks())
+		if(CBattleInfoCallback::battleKeepsSideFighting(getStackState(stack).getBonusBearer()))
+			hasStacks[!stack->attackerOwned] = true;
+
+	return CBattleInfoCallback::battleIsFinished(hasStacks[0], hasStacks[1]);
+}
+
+AccessibilityInfo HypotheticBattle::getAccesibility() const
+{
+	auto ret = cb->getAccesibility();
+	if(!positionsChanged)
+		return ret;
+
+	//free hexes left by changed stacks first, other changed stack may have moved there
+	for(auto & changed : changedStacks)
+		if(changed.first->alive())
+			for(auto hex : changed.first->getHexes())
+				if(hex.isAvailable())
+					ret[hex] = EAccessibility::ACCESSIBLE;
+
+	for(auto & changed : changedStacks)
+		if(changed.second->alive())
+			for(auto hex : changed.second->getHexes())
+				if(hex.isAvailable())
+					ret[hex] = EAccessibility::ALIVE_STACK;
+
+	return ret;
+}
+
+ReachabilityInfo HypotheticBattle::getReachability(const CStack * stack) const
+{
+	const auto state = getStackState(stack);
+	ReachabilityInfo::Parameters params(stack);
+	params.perspective = cb->battleGetMySide();
+	params.startPosition = state.position;
+	params.knownAccessible = state.getHexes();
+
+	if(!positionsChanged)
+		return cb->getReachability(params);
+
+	auto accessibility = getAccesibility();
+	for(auto hex : params.knownAccessible)
+		if(hex.isValid())
+			accessibility[hex] = EAccessibility::ACCESSIBLE;
+	return cb->getReachability(accessibility, params);
+}
+
+std::vector<BattleHex> HypotheticBattle::battleGetAvailableHexes(const CStack * stack) const
+{
+	if(!positionsChanged)
+		return cb->battleGetAvailableHexes(stack, false);
+
+	const auto state = getStackState(stack);
+	if(!state.position.isValid()) //turrets
+		return std::vector<BattleHex>();
+
+	return cb->battleGetAvailableHexes(stack, getReachability(stack), state.getBonusBearer()->Speed(0, true));
+}
+
+bool HypotheticBattle::battleCanShoot(const CStack * stack, const CStack * target) const
+{
+	if(!positionsChanged && !vstd::contains(changedStacks, stack) && !vstd::contains(changedStacks, target))
+		return cb->battleCanShoot(stack, target->position);
+
+	const auto shooter = getStackState(stack);
+	if(!shooter.alive() || !isAlive(target) || stack->attackerOwned == target->attackerOwned)
+		return false;
+
+	return cb->battleCanShoot(stack, shooter.getBonusBearer(), shooter.shots, battleIsStackBlocked(stack));
+}
+
+bool HypotheticBattle::battleIsStackBlocked(const CStack * stack) const
+{
+	const auto state = getStackState(stack);
+	for(auto hex : stack->getSurroundingHexes(state.position))
+	{
+		if(CBattleInfoCallback::battleIsStackBlockedBy(stack, state.getBonusBearer(), battleGetStackByPos(hex)))
+			return true;
+	}
+	return false;
+}
+
+BattleAttackInfo HypotheticBattle::makeAttackInfo(const CStack * attacker, const CStack * defender, bool shooting) const
+{
+	const auto attackerState = getStackState(attacker);
+	const auto defenderState = getStackState(defender);
+
+	BattleAttackInfo bai(attacker, defender, shooting);
+	bai.attackerBonuses = attackerState.getBonusBearer();
+	bai.defenderBonuses = defenderState.getBonusBearer();
+	bai.attackerPosition = attackerState.position;
+	bai.defenderPosition = defenderState.position;
+	bai.attackerCount = attackerState.count;
+	bai.defenderCount = defenderState.count;
+	return bai;
+}
+
+void HypotheticBattle::addEffects(const CStack * stack, const std::vector<Bonus> & effects)
+{
+	auto & state = modifyStack(stack);
+	auto bonuses = state.bonuses ? std::make_shared<StackWithBonuses>(*state.bonuses) : std::make_shared<StackWithBonuses>();
+	bonuses->stack = stack;
+	range::copy(effects, std::back_inserter(bonuses->bonusesToAdd));
+	state.bonuses = bonuses;
+}
+
+void HypotheticBattle::moveStack(const CStack * stack, BattleHex dest)
+{
+	modifyStack(stack).position = dest;
+	positionsChanged = true;
+}
+
+void HypotheticBattle::damageStack(const CStack * stack, int damage)
+{
+	if(damage <= 0)
+		return;
+
+	auto & state = modifyStack(stack);
+	const auto afterAttack = state.countKilledByAttack(damage);
+	if(afterAttack.first >= static_cast<int>(state.count))
+	{
+		state.count = 0;
+		state.firstHPleft = 0;
+		positionsChanged = true;
+	}
+	else
+	{
+		state.count -= afterAttack.first;
+		state.firstHPleft = afterAttack.second;
+	}
+}
+
+void HypotheticBattle::makeAttack(const AttackPossibility & ap)
+{
+	const CStack * attacker = ap.attack.attacker;
+	if(ap.tile.isValid() && ap.tile != getStackState(attacker).position)
+		moveStack(attacker, ap.tile);
+
+	if(ap.attack.shooting)
+		modifyStack(attacker).shots--;
+	else if(ap.damageReceived)
+		modifyStack(ap.enemy).counterAttacks--;
+
+	damageStack(ap.enemy, ap.damageDealt);
+	damageStack(attacker, ap.damageReceived);
+}
+
+int HypotheticBattle::evaluate(ui8 side) const
+{
+	double ret = 0;
+	for(auto stack : battleAliveStacks())
+	{
+		const auto state = getStackState(stack);
+		const double value = stack->getCreature()->AIValue * static_cast<double>(state.totalHealth()) / state.getBonusBearer()->MaxHealth();
+		if(stack->attackerOwned == !side)
+			ret += value;
+		else
+			ret -= value;
+	}
+	return static_cast<int>(ret);
+}
+
+HypotheticBattle::StackState HypotheticBattle::initialState(const CStack * stack) const
+{
+	StackState ret(stack);
+	if(bonusSnapshots)
+	{
+		auto it = bonusSnapshots->find(stack);
+		if(it != bonusSnapshots->end())
+			ret.bonuses = it->second;
+	}
+	return ret;
+}
+
+HypotheticBattle::StackState & HypotheticBattle::modifyStack(const CStack * stack)
+{
+	auto & state = changedStacks[stack];
+	if(!state)
+		state = std::make_shared<StackState>(initialState(stack));
+	else if(state.use_count() > 1)
+		state = std::make_shared<StackState>(*state);
+	return *state;
+}
@@ -0,0 +1,83 @@
+/*
+ * HypotheticBattle.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#pragma once
+#include "../../lib/BattleState.h"
+#include "../../CCallback.h"
+#include "StackWithBonuses.h"
+#include "common.h"
+
+class AttackPossibility;
+
+/// Battle as it would be after some actions, for looking ahead without touching the real battle.
+/// Only stacks changed by these actions are stored, everything else is asked from the callback.
+/// Copying is cheap: copies share states of stacks and a state is cloned when a copy changes it (copy-on-write).
+class HypotheticBattle
+{
+public:
+	struct StackState
+	{
+		const CStack * stack;
+		BattleHex position;
+		ui32 count;
+		ui32 firstHPleft;
+		si32 counterAttacks;
+		si16 shots;
+		std::shared_ptr<const StackWithBonuses> bonuses; //stack with effects applied in this battle, null if there are none
+
+		explicit StackState(const CStack * Stack);
+
+		bool alive() const;
+		ui32 totalHealth() const;
+		std::pair<int, int> countKilledByAttack(int damageReceived) const; //returns pair<killed count, new left HP>
+		std::vector<BattleHex> getHexes() const;
+		const IBonusBearer * getBonusBearer() const;
+	};
+
+	HypotheticBattle(); //real battle as seen by getCbc()
+	explicit HypotheticBattle(std::shared_ptr<CBattleCallback> CB);
+
+	/// Copies bonuses of all stacks, so this battle and its copies can be queried from several threads
+	/// without serializing on caches of the bonus system. Has to be called before any change.
+	void snapshotBonuses();
+
+	StackState getStackState(const CStack * stack) const;
+	bool isAlive(const CStack * stack) const;
+
+	//counterparts of CBattleInfoCallback queries, taking changes into account
+	//CBattleInfoCallback reads positions, counts and bonuses from CStack directly, so it can't be given this state;
+	//these are the queries lookahead needs, the battle rules themselves come from its static and state-taking helpers
+	std::vector<const CStack *> battleAliveStacks() const;
+	const CStack * battleGetStackByPos(BattleHex pos) const;
+	boost::optional<int> battleIsFinished() const; //none if battle is ongoing, otherwise the side (0/1) with alive stacks or 2 if none has
+	AccessibilityInfo getAccesibility() const;
+	ReachabilityInfo getReachability(const CStack * stack) const;
+	std::vector<BattleHex> battleGetAvailableHexes(const CStack * stack) const;
+	bool battleCanShoot(const CStack * stack, const CStack * target) const;
+	bool battleIsStackBlocked(const CStack * stack) const;
+	BattleAttackInfo makeAttackInfo(const CStack * attacker, const CStack * defender, bool shooting) const; //with current counts and bonuses, for battleEstimateDamage
+
+	//changes
+	void addEffects(const CStack * stack, const std::vector<Bonus> & effects);
+	void moveStack(const CStack * stack, BattleHex dest);
+	void damageStack(const CStack * stack, int damage);
+	void makeAttack(const AttackPossibility & ap); //moves attacker to ap.tile and deals expected damages of attack and retaliation
+
+	int evaluate(ui8 side) const; //AI value of alive creatures of given side minus value of enemy ones
+
+private:
+	std::shared_ptr<CBattleCallback> cb;
+	std::vector<const CStack *> stacks; //alive stacks of the real battle
+	std::map<const CStack *, std::shared_ptr<StackState>> changedStacks; //states may be shared with copies of this battle
+	bool positionsChanged; //some stack moved or died, accessibility and reachability have to be calculated here instead of asking callback
+	std::shared_ptr<const std::map<const CStack *, std::shared_ptr<const StackWithBonuses>>> bonusSnapshots; //null if bonuses are asked from stacks
+
+	StackState initialState(const CStack * stack) const; //state of stack in the real battle
+	StackState & modifyStack(const CStack * stack); //state of stack owned only by this battle, cloned if shared
+};
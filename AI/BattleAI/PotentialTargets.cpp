@@ -10,12 +10,12 @@
 #include "StdInc.h"
 #include "PotentialTargets.h"
 
-PotentialTargets::PotentialTargets(const CStack *attacker, const HypotheticChangesToBattleState &state /*= HypotheticChangesToBattleState()*/)
+PotentialTargets::PotentialTargets(const CStack *attacker, const HypotheticBattle &state /*= HypotheticBattle()*/)
 {
-	auto dists = getCbc()->battleGetDistances(attacker);
-	auto avHexes = getCbc()->battleGetAvailableHexes(attacker, false);
+	auto dists = state.getReachability(attacker).distances;
+	auto avHexes = state.battleGetAvailableHexes(attacker);
 
-	for(const CStack *enemy : getCbc()->battleGetStacks())
+	for(const CStack *enemy : state.battleAliveStacks())
 	{
 		//Consider only stacks of different owner
 		if(enemy->attackerOwned == attacker->attackerOwned)
@@ -23,9 +23,7 @@ PotentialTargets::PotentialTargets(const CStack *attacker, const HypotheticChang
 
 		auto GenerateAttackInfo = [&](bool shooting, BattleHex hex) -> AttackPossibility
 		{
-			auto bai = BattleAttackInfo(attacker, enemy, shooting);
-			bai.attackerBonuses = getValOr(state.bonusesOfStacks, bai.attacker, bai.attacker);
-			bai.defenderBonuses = getValOr(state.bonusesOfStacks, bai.defender, bai.defender);
+			auto bai = state.makeAttackInfo(attacker, enemy, shooting);
 
 			if(hex.isValid())
 			{
@@ -36,14 +34,15 @@ PotentialTargets::PotentialTargets(const CStack *attacker, const HypotheticChang
 			return AttackPossibility::evaluate(bai, state, hex);
 		};
 
-		if(getCbc()->battleCanShoot(attacker, enemy->position))
+		if(state.battleCanShoot(attacker, enemy))
 		{
 			possibleAttacks.push_back(GenerateAttackInfo(true, BattleHex::INVALID));
 		}
 		else
 		{
+			const BattleHex enemyPosition = state.getStackState(enemy).position;
 			for(BattleHex hex : avHexes)
-				if(CStack::isMeleeAttackPossible(attacker, enemy, hex))
+				if(CStack::isMeleeAttackPossible(attacker, enemy, hex, enemyPosition))
 					possibleAttacks.push_back(GenerateAttackInfo(false, hex));
 
 			if(!vstd::contains_if(possibleAttacks, [=](const AttackPossibility &pa) { return pa.enemy == enemy; }))
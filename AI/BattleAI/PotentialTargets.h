@@ -19,7 +19,7 @@ public:
 	//std::function<AttackPossibility(bool,BattleHex)>  GenerateAttackInfo; //args: shooting, destHex
 
 	PotentialTargets(){};
-	PotentialTargets(const CStack *attacker, const HypotheticChangesToBattleState &state = HypotheticChangesToBattleState());
+	PotentialTargets(const CStack *attacker, const HypotheticBattle &state = HypotheticBattle());
 
 	AttackPossibility bestAction() const;
 	int bestActionValue() const;
@@ -15,8 +15,15 @@ const TBonusListPtr StackWithBonuses::getAllBonuses(const CSelector &selector, c
 						    const CBonusSystemNode *root /*= nullptr*/, const std::string &cachingStr /*= ""*/) const
 {
 	TBonusListPtr ret = std::make_shared<BonusList>();
-	const TBonusListPtr originalList = stack->getAllBonuses(selector, limit, root, cachingStr);
-	range::copy(*originalList, std::back_inserter(*ret));
+	if(snapshot && (!root || root == stack))
+	{
+		snapshot->getBonuses(*ret, selector, limit);
+	}
+	else
+	{
+		const TBonusListPtr originalList = stack->getAllBonuses(selector, limit, root, cachingStr);
+		range::copy(*originalList, std::back_inserter(*ret));
+	}
 	for(auto &bonus : bonusesToAdd)
 	{
 		auto b = std::make_shared<Bonus>(bonus);
@@ -17,6 +17,7 @@ class StackWithBonuses : public IBonusBearer
 public:
 	const CStack *stack;
 	mutable std::vector<Bonus> bonusesToAdd;
+	TBonusListPtr snapshot; //if set, bonuses of stack are selected from this copy without locking bonus system caches
 
 	virtual const TBonusListPtr getAllBonuses(const CSelector &selector, const CSelector &limit,
 						  const CBonusSystemNode *root = nullptr, const std::string &cachingStr = "") const override;
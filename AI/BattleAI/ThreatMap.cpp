@@ -43,7 +43,7 @@ ThreatMap::ThreatMap(const CStack *Endangered) : endangered(Endangered)
 			if(enemyReachability.isReachable(i))
 			{
 				meleeAttackable[i] = true;
-				for(auto n : BattleHex(i).neighbouringTiles())
+				for(auto n : BattleHex(i).neighbouringTilesView())
 					meleeAttackable[n] = true;
 			}
 		}
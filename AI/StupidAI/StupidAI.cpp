@@ -65,7 +65,7 @@ namespace {
 int distToNearestNeighbour(BattleHex hex, const ReachabilityInfo::TDistances& dists, BattleHex *chosenHex = nullptr)
 {
 	int ret = 1000000;
-	for(auto & n: hex.neighbouringTiles())
+	for(auto & n: hex.neighbouringTilesView())
 	{
 		if(dists[n] >= 0 && dists[n] < ret)
 		{
@@ -90,7 +90,7 @@ static bool willSecondHexBlockMoreEnemyShooters(const BattleHex &h1, const Battl
 	int shooters[2] = {0}; //count of shooters on hexes
 
 	for(int i = 0; i < 2; i++)
-		for (auto & neighbour : (i ? h2 : h1).neighbouringTiles())
+		for (auto & neighbour : (i ? h2 : h1).neighbouringTilesView())
 			if(const CStack *s = cbc->battleGetStackByPos(neighbour))
 				if(s->getCreature()->isShooting())
 						shooters[i]++;
@@ -769,9 +769,14 @@ void VCAI::makeTurn()
 	}
 	markHeroAbleToExplore (primaryHero());
 
+	CBonusSystemNode::resetCachingStats();
 	makeTurnInternal();
 	makingTurn.reset();
 
+	auto stats = CBonusSystemNode::getCachingStats();
+	logAi->debug("Bonus cache during turn: tree hits %d, misses %d; request hits %d, misses %d",
+		stats.treeHits, stats.treeMisses, stats.requestHits, stats.requestMisses);
+
 	return;
 }
 
@@ -821,6 +826,7 @@ void VCAI::makeTurnInternal()
 			oldMovement = newMovement; //remember old value
 			newMovement = 0;
 			std::vector<std::pair<HeroPtr, Goals::TSubgoal> > safeCopy;
+			cb->calculatePaths(cb->getHeroesInfo()); //priorities of all missions depend on paths of their heroes
 			for (auto mission : lockedHeroes)
 			{
 				fh->setPriority (mission.second); //re-evaluate
@@ -1819,9 +1825,10 @@ const CGObjectInstance * VCAI::lookForArt(int aid) const
 
 bool VCAI::isAccessible(const int3 &pos)
 {
-	//TODO precalculate for speed
+	auto heroes = cb->getHeroesInfo();
+	cb->calculatePaths(heroes); //all of them will be queried, let them be calculated in parallel
 
-	for(const CGHeroInstance *h : cb->getHeroesInfo())
+	for(const CGHeroInstance *h : heroes)
 	{
 		if(isAccessibleForHero(pos, h))
 			return true;
@@ -297,6 +297,11 @@ void CCallback::calculatePaths( const CGHeroInstance *hero, CPathsInfo &out)
 	gs->calculatePaths(hero, out);
 }
 
+void CCallback::calculatePaths(const std::vector<const CGHeroInstance *> &heroes)
+{
+	cl->calculatePaths(heroes);
+}
+
 void CCallback::dig( const CGObjectInstance *hero )
 {
 	DigWithHero dwh;
@@ -108,6 +108,7 @@ public:
 	virtual const CPathsInfo * getPathsInfo(const CGHeroInstance *h);
 
 	virtual void calculatePaths(const CGHeroInstance *hero, CPathsInfo &out);
+	virtual void calculatePaths(const std::vector<const CGHeroInstance *> &heroes); //calculates paths of all given heroes concurrently, use getPathsInfo to access them
 
 	//Set of metrhods that allows adding more interfaces for this player that'll receive game event call-ins.
 	void registerGameInterface(std::shared_ptr<IGameEventsReceiver> gameEvents);
@@ -119,9 +119,7 @@ void startGameFromFile(const bfs::path &fname)
 		if(fname.empty() || !bfs::exists(fname))
 			throw std::runtime_error("Startfile \"" + fname.string() + "\" does not exist!");
 
-		CLoadFile out(fname);
-		if (!out.sfile || !*out.sfile)
-			throw std::runtime_error("Cannot read from startfile \"" + fname.string() +"\"!");
+		CLoadFile out(fname); //throws if file can't be opened
 		out >> si;
 	}
 	catch(std::exception &e)
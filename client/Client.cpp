@@ -22,6 +22,7 @@
 #include "../lib/serializer/CTypeList.h"
 #include "../lib/serializer/Connection.h"
 #include "../lib/serializer/CLoadIntegrityValidator.h"
+#include "../lib/serializer/CGameStateSnapshots.h"
 #ifndef VCMI_ANDROID
 #include "../lib/Interprocess.h"
 #endif
@@ -102,12 +103,13 @@ public:
 
 
 static CApplier<CBaseForCLApply> *applier = nullptr;
+static const size_t MIN_CACHED_PATHS = 4; //interfaces compare paths of few heroes at once
 
 void CClient::init()
 {
+	pathCacheCapacity = MIN_CACHED_PATHS;
 	hotSeat = false;
 	connectionHandler = nullptr;
-	pathInfo = nullptr;
 	applier = new CApplier<CBaseForCLApply>;
 	registerTypesClientPacks1(*applier);
 	registerTypesClientPacks2(*applier);
@@ -207,6 +209,8 @@ void CClient::endGame(bool closeConnection /*= true*/)
 	for (auto& i : playerint)
 		i.second->finish();
 
+	CBackgroundSaveWriter::get().waitForAll(); //savegames being written refer to game state
+
 	// Game is ending
 	// Tell the network thread to reach a stable state
 	if (closeConnection)
@@ -268,6 +272,7 @@ void CClient::loadGame(const std::string & fname, const bool server, const std::
 	std::unique_ptr<CLoadFile> loader;
 	try
 	{
+		CBackgroundSaveWriter::get().waitForAll(); //this savegame may be still being written
 		boost::filesystem::path clientSaveName = *CResourceHandler::get("local")->getResourceName(ResourceID(fname, EResType::CLIENT_SAVEGAME));
 		boost::filesystem::path controlServerSaveName;
 
@@ -286,6 +291,13 @@ void CClient::loadGame(const std::string & fname, const bool server, const std::
 		if(controlServerSaveName.empty() || !boost::filesystem::exists(controlServerSaveName))
 			throw std::runtime_error("Cannot open server part of " + fname);
 
+		if(!CGameStateSnapshots::getSnapshotName(clientSaveName).empty() || !CGameStateSnapshots::getSnapshotName(controlServerSaveName).empty())
+		{
+			//delta savegames refer to different snapshots of client and server, they can't be compared
+			loader = make_unique<CLoadFile>(clientSaveName, MINIMAL_SERIALIZATION_VERSION);
+			loadCommonState(*loader);
+		}
+		else
 		{
 			CLoadIntegrityValidator checkingLoader(clientSaveName, controlServerSaveName, MINIMAL_SERIALIZATION_VERSION);
 			loadCommonState(checkingLoader);
@@ -294,7 +306,9 @@ void CClient::loadGame(const std::string & fname, const bool server, const std::
 		logNetwork->infoStream() << "Loaded common part of save " << tmh.getDiff();
 		const_cast<CGameInfo*>(CGI)->mh = new CMapHandler();
 		const_cast<CGameInfo*>(CGI)->mh->map = gs->map;
-		pathInfo = make_unique<CPathsInfo>(getMapSize());
+		pathCache.clear();
+		pathChanges.clear();
+		pathGraphs.clear();
 		CGI->mh->init();
 		logNetwork->infoStream() <<"Initing maphandler: "<<tmh.getDiff();
 	}
@@ -439,7 +453,9 @@ void CClient::newGame( CConnection *con, StartInfo *si )
 		CGI->mh->map = gs->map;
 		logNetwork->infoStream() << "Creating mapHandler: " << tmh.getDiff();
 		CGI->mh->init();
-		pathInfo = make_unique<CPathsInfo>(getMapSize());
+		pathCache.clear();
+		pathChanges.clear();
+		pathGraphs.clear();
 		logNetwork->infoStream() << "Initializing mapHandler (together): " << tmh.getDiff();
 	}
 
@@ -817,19 +833,171 @@ void CClient::commenceTacticPhaseForInt(std::shared_ptr<CBattleGameInterface> ba
 void CClient::invalidatePaths()
 {
 	// turn pathfinding info into invalid. It will be regenerated later
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	for(auto & pathInfo : pathCache)
+	{
+		boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
+		pathInfo->hero = nullptr;
+	}
+	pathChanges.clear();
+	for(auto & graph : pathGraphs)
+		graph.second->invalidate();
+}
+
+void CClient::invalidatePaths(const CGHeroInstance *h)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	if(auto pathInfo = findCachedPaths(h))
+	{
+		boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
+		pathInfo->hero = nullptr;
+		pathChanges.erase(pathInfo);
+	}
+}
+
+void CClient::removePaths(const CGHeroInstance *h)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	if(auto pathInfo = findCachedPaths(h))
+	{
+		pathChanges.erase(pathInfo);
+		vstd::erase_if(pathCache, [pathInfo](const std::unique_ptr<CPathsInfo> & entry){ return entry.get() == pathInfo; });
+	}
+}
+
+void CClient::invalidatePaths(const std::vector<int3> & tiles)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	for(auto & graph : pathGraphs)
+		graph.second->invalidate(tiles);
+
+	for(auto & pathInfo : pathCache)
+	{
+		if(!pathInfo->hero)
+			continue;
+
+		auto & changes = pathChanges[pathInfo.get()];
+		changes.insert(changes.end(), tiles.begin(), tiles.end());
+
+		//repairing large part of the map costs more than calculating paths from scratch
+		if(changes.size() * 9 > pathInfo->sizes.x * pathInfo->sizes.y * pathInfo->sizes.z / 4)
+		{
+			boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
+			pathInfo->hero = nullptr;
+			pathChanges.erase(pathInfo.get());
+		}
+	}
+}
+
+CPathsInfo * CClient::findCachedPaths(const CGHeroInstance *h)
+{
+	auto it = boost::find_if(pathCache, [h](const std::unique_ptr<CPathsInfo> & pathInfo){ return pathInfo->hero == h; });
+	if(it == pathCache.end())
+		return nullptr;
+
+	std::rotate(it, it + 1, pathCache.end());
+	return pathCache.back().get();
+}
+
+CPathsInfo * CClient::allocCachedPaths()
+{
+	if(auto pathInfo = findCachedPaths(nullptr))
+		return pathInfo;
+
+	if(pathCache.size() >= pathCacheCapacity)
+	{
+		auto pathInfo = pathCache.front().get();
+		pathChanges.erase(pathInfo);
+		std::rotate(pathCache.begin(), pathCache.begin() + 1, pathCache.end());
+		boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
+		pathInfo->hero = nullptr;
+		return pathInfo;
+	}
+
+	pathCache.push_back(make_unique<CPathsInfo>(getMapSize()));
+	return pathCache.back().get();
+}
+
+void CClient::trimPathCache()
+{
+	for(auto it = pathCache.begin(); it != pathCache.end() && pathCache.size() > pathCacheCapacity;)
+	{
+		if(!(*it)->hero)
+			it = pathCache.erase(it);
+		else
+			it++;
+	}
+
+	while(pathCache.size() > pathCacheCapacity)
+	{
+		pathChanges.erase(pathCache.front().get());
+		pathCache.erase(pathCache.begin());
+	}
+}
+
+void CClient::updateCachedPaths(CPathsInfo * pathInfo)
+{
+	auto changes = pathChanges.find(pathInfo);
+	if(changes == pathChanges.end())
+		return;
+
 	boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
-	pathInfo->hero = nullptr;
+	pathInfo->graph = getPathsGraph(pathInfo->hero->tempOwner);
+	gs->updatePaths(pathInfo->hero, *pathInfo, changes->second);
+	pathChanges.erase(changes);
 }
 
 const CPathsInfo * CClient::getPathsInfo(const CGHeroInstance *h)
 {
 	assert(h);
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	if(auto pathInfo = findCachedPaths(h))
+	{
+		updateCachedPaths(pathInfo);
+		return pathInfo;
+	}
+
+	auto pathInfo = allocCachedPaths();
 	boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
-	if (pathInfo->hero != h)
+	pathInfo->graph = getPathsGraph(h->tempOwner);
+	gs->calculatePaths(h, *pathInfo);
+	return pathInfo;
+}
+
+CPathsGraph * CClient::getPathsGraph(PlayerColor player)
+{
+	auto & graph = pathGraphs[player];
+	if(!graph)
+		graph = make_unique<CPathsGraph>(player);
+	return graph.get();
+}
+
+void CClient::calculatePaths(const std::vector<const CGHeroInstance *> & heroes)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	//entries used by this batch become most recently used, so none of them is reused for another hero of the batch
+	pathCacheCapacity = std::max(MIN_CACHED_PATHS, heroes.size());
+	trimPathCache();
+
+	std::vector<std::pair<const CGHeroInstance *, CPathsInfo *>> jobs;
+	for(auto h : heroes)
 	{
-		gs->calculatePaths(h, *pathInfo.get());
+		if(auto pathInfo = findCachedPaths(h))
+		{
+			updateCachedPaths(pathInfo);
+			continue;
+		}
+
+		//entry is claimed right away, so it is found for duplicates and not handed out again in this batch
+		auto pathInfo = allocCachedPaths();
+		boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
+		pathInfo->hero = h;
+		pathInfo->graph = getPathsGraph(h->tempOwner);
+		jobs.push_back(std::make_pair(h, pathInfo));
 	}
-	return pathInfo.get();
+
+	if(!jobs.empty())
+		gs->calculatePaths(jobs);
 }
 
 int CClient::sendRequest(const CPack *request, PlayerColor player)
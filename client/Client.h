@@ -32,6 +32,7 @@ struct SharedMem;
 class CClient;
 class CScriptingModule;
 struct CPathsInfo;
+struct CPathsGraph;
 class BinaryDeserializer;
 class BinarySerializer;
 namespace boost { class thread; }
@@ -116,7 +117,20 @@ public:
 /// Class which handles client - server logic
 class CClient : public IGameCallback
 {
-	std::unique_ptr<CPathsInfo> pathInfo;
+	/// Paths of recently queried heroes, least recently used first. Entries invalidated by invalidatePaths() are reused for other heroes,
+	/// entries above pathCacheCapacity are freed. Pointer returned by getPathsInfo stays valid until paths of other heroes are queried.
+	std::vector<std::unique_ptr<CPathsInfo>> pathCache;
+	size_t pathCacheCapacity; //enough for the last calculatePaths batch
+	boost::mutex pathCacheMx;
+
+	std::map<const CPathsInfo *, std::vector<int3>> pathChanges; //tiles changed since cached paths were calculated
+	std::map<PlayerColor, std::unique_ptr<CPathsGraph>> pathGraphs; //accessibility of tiles shared by heroes of each player
+
+	CPathsInfo * findCachedPaths(const CGHeroInstance *h); //requires pathCacheMx, marks found entry as most recently used
+	CPathsInfo * allocCachedPaths(); //requires pathCacheMx, returns free or least recently used entry and marks it as most recently used
+	void trimPathCache(); //requires pathCacheMx, frees entries above capacity, unused ones first
+	void updateCachedPaths(CPathsInfo * pathInfo); //requires pathCacheMx
+	CPathsGraph * getPathsGraph(PlayerColor player); //requires pathCacheMx
 public:
 	std::map<PlayerColor,std::shared_ptr<CCallback> > callbacks; //callbacks given to player interfaces
 	std::map<PlayerColor,std::shared_ptr<CBattleCallback> > battleCallbacks; //callbacks given to player interfaces
@@ -161,7 +175,11 @@ public:
 	void proposeNextMission(std::shared_ptr<CCampaignState> camp);
 
 	void invalidatePaths();
+	void invalidatePaths(const CGHeroInstance *h); //only paths of given hero are affected
+	void removePaths(const CGHeroInstance *h); //hero left the map, its paths are freed
+	void invalidatePaths(const std::vector<int3> & tiles); //objects or visibility of tiles changed, cached paths will be updated incrementally
 	const CPathsInfo * getPathsInfo(const CGHeroInstance *h);
+	void calculatePaths(const std::vector<const CGHeroInstance *> & heroes); //calculates paths of all given heroes concurrently, results are then returned by getPathsInfo
 
 	bool terminate;	// tell to terminate
 	boost::thread *connectionHandler; //thread running run() method
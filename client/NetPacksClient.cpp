@@ -106,6 +106,13 @@
  *
  */
 
+//movement of hero depends on speed of its army and on its artifacts, cached paths have to be recalculated
+static void invalidateArmyPaths(CClient *cl, const CArmedInstance *army)
+{
+	if(auto hero = dynamic_cast<const CGHeroInstance *>(army))
+		cl->invalidatePaths(hero);
+}
+
 void SetResources::applyCl(CClient *cl)
 {
 	//todo: inform on actual resource set transfered
@@ -178,7 +185,7 @@ void FoWChange::applyCl(CClient *cl)
 				i.second->tileHidden(tiles);
 		}
 	}
-	cl->invalidatePaths();
+	cl->invalidatePaths(std::vector<int3>(tiles.begin(), tiles.end()));
 }
 
 void SetAvailableHeroes::applyCl(CClient *cl)
@@ -188,21 +195,26 @@ void SetAvailableHeroes::applyCl(CClient *cl)
 
 void ChangeStackCount::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, sl.army);
 	INTERFACE_CALL_IF_PRESENT(sl.army->tempOwner, stackChagedCount, sl, count, absoluteValue);
 }
 
 void SetStackType::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, sl.army);
 	INTERFACE_CALL_IF_PRESENT(sl.army->tempOwner, stackChangedType, sl, *type);
 }
 
 void EraseStack::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, sl.army);
 	INTERFACE_CALL_IF_PRESENT(sl.army->tempOwner, stacksErased, sl);
 }
 
 void SwapStacks::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, sl1.army);
+	invalidateArmyPaths(cl, sl2.army);
 	INTERFACE_CALL_IF_PRESENT(sl1.army->tempOwner, stacksSwapped, sl1, sl2);
 	if(sl1.army->tempOwner != sl2.army->tempOwner)
 		INTERFACE_CALL_IF_PRESENT(sl2.army->tempOwner, stacksSwapped, sl1, sl2);
@@ -210,11 +222,14 @@ void SwapStacks::applyCl(CClient *cl)
 
 void InsertNewStack::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, sl.army);
 	INTERFACE_CALL_IF_PRESENT(sl.army->tempOwner,newStackInserted,sl, *sl.getStack());
 }
 
 void RebalanceStacks::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, src.army);
+	invalidateArmyPaths(cl, dst.army);
 	INTERFACE_CALL_IF_PRESENT(src.army->tempOwner, stacksRebalanced, src, dst, count);
 	if(src.army->tempOwner != dst.army->tempOwner)
 		INTERFACE_CALL_IF_PRESENT(dst.army->tempOwner,stacksRebalanced, src, dst, count);
@@ -222,16 +237,20 @@ void RebalanceStacks::applyCl(CClient *cl)
 
 void PutArtifact::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, al.relatedObj());
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactPut, al);
 }
 
 void EraseArtifact::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, al.relatedObj());
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactRemoved, al);
 }
 
 void MoveArtifact::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, src.relatedObj());
+	invalidateArmyPaths(cl, dst.relatedObj());
 	INTERFACE_CALL_IF_PRESENT(src.owningPlayer(), artifactMoved, src, dst);
 	if(src.owningPlayer() != dst.owningPlayer())
 		INTERFACE_CALL_IF_PRESENT(dst.owningPlayer(), artifactMoved, src, dst);
@@ -239,11 +258,13 @@ void MoveArtifact::applyCl(CClient *cl)
 
 void AssembledArtifact::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, al.relatedObj());
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactAssembled, al);
 }
 
 void DisassembledArtifact::applyCl(CClient *cl)
 {
+	invalidateArmyPaths(cl, al.relatedObj());
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactDisassembled, al);
 }
 
@@ -261,7 +282,11 @@ void NewTurn::applyCl(CClient *cl)
 
 void GiveBonus::applyCl(CClient *cl)
 {
-	cl->invalidatePaths();
+	if(who == HERO)
+		cl->invalidatePaths(GS(cl)->getHero(ObjectInstanceID(id)));
+	else
+		cl->invalidatePaths();
+
 	switch(who)
 	{
 	case HERO:
@@ -301,7 +326,11 @@ void PlayerEndsGame::applyCl(CClient *cl)
 
 void RemoveBonus::applyCl(CClient *cl)
 {
-	cl->invalidatePaths();
+	if(who == HERO)
+		cl->invalidatePaths(GS(cl)->getHero(ObjectInstanceID(id)));
+	else
+		cl->invalidatePaths();
+
 	switch(who)
 	{
 	case HERO:
@@ -336,6 +365,17 @@ void RemoveObject::applyFirstCl(CClient *cl)
 
 	CGI->mh->hideObject(o, true);
 
+	if(o->ID != Obj::HERO)
+	{
+		auto blockedPos = o->getBlockedPos();
+		affectedTiles.assign(blockedPos.begin(), blockedPos.end());
+		affectedTiles.push_back(o->visitablePos());
+	}
+	else
+	{
+		cl->removePaths(static_cast<const CGHeroInstance *>(o));
+	}
+
 	//notify interfaces about removal
 	for(auto i=cl->playerint.begin(); i!=cl->playerint.end(); i++)
 	{
@@ -346,7 +386,10 @@ void RemoveObject::applyFirstCl(CClient *cl)
 
 void RemoveObject::applyCl(CClient *cl)
 {
-	cl->invalidatePaths();
+	if(affectedTiles.empty())
+		cl->invalidatePaths();
+	else
+		cl->invalidatePaths(affectedTiles);
 }
 
 void TryMoveHero::applyFirstCl(CClient *cl)
@@ -470,6 +513,7 @@ void HeroRecruited::applyCl(CClient *cl)
 	{
 		logNetwork->errorStream() << "Something wrong with hero recruited!";
 	}
+	cl->invalidatePaths(); //new hero blocks its tile
 
 	bool needsPrinting = true;
 	if(vstd::contains(cl->playerint, h->tempOwner))
@@ -490,6 +534,7 @@ void HeroRecruited::applyCl(CClient *cl)
 void GiveHero::applyCl(CClient *cl)
 {
 	CGHeroInstance *h = GS(cl)->getHero(id);
+	cl->invalidatePaths(); //hero is placed on map and changes owner
 	CGI->mh->printObject(h);
 	cl->playerint[h->tempOwner]->heroCreated(h);
 }
@@ -517,10 +562,22 @@ void InfoWindow::applyCl(CClient *cl)
 
 void SetObjectProperty::applyCl(CClient *cl)
 {
+	const CGObjectInstance *obj = GS(cl)->getObjInstance(id);
+	if(what == ObjProperty::OWNER && obj && obj->ID != Obj::HERO)
+	{
+		//owner decides if object (like garrison) can be passed, tiles of shared graphs are evaluated again
+		auto blockedPos = obj->getBlockedPos();
+		std::vector<int3> changedTiles(blockedPos.begin(), blockedPos.end());
+		changedTiles.push_back(obj->visitablePos());
+		cl->invalidatePaths(changedTiles);
+	}
+	else
+		cl->invalidatePaths(); //state of object may decide if it can be passed or visited
+
 	//inform all players that see this object
 	for(auto it = cl->playerint.cbegin(); it != cl->playerint.cend(); ++it)
 	{
-		if(GS(cl)->isVisible(GS(cl)->getObjInstance(id), it->first))
+		if(GS(cl)->isVisible(obj, it->first))
 			INTERFACE_CALL_IF_PRESENT(it->first, objectPropertyChanged, this);
 	}
 }
@@ -792,9 +849,15 @@ void SaveGame::applyCl(CClient *cl)
 
 	try
 	{
-		CSaveFile save(*CResourceHandler::get()->getResourceName(ResourceID(stem.to_string(), EResType::CLIENT_SAVEGAME)));
-		cl->saveCommonState(save);
+		const auto savePath = *CResourceHandler::get()->getResourceName(ResourceID(stem.to_string(), EResType::CLIENT_SAVEGAME));
+		CSaveFile save(savePath, true, true);
+		const ui32 saveId = cl->saveCommonState(save);
 		save << *cl;
+		save.close([cl, savePath, saveId](bool success)
+		{
+			if(success)
+				cl->saveFinished(savePath, saveId);
+		});
 	}
 	catch(std::exception &e)
 	{
@@ -900,9 +963,11 @@ void CenterView::applyCl(CClient *cl)
 
 void NewObject::applyCl(CClient *cl)
 {
-	cl->invalidatePaths();
-
 	const CGObjectInstance *obj = cl->getObj(id);
+	auto blockedPos = obj->getBlockedPos();
+	std::vector<int3> changedTiles(blockedPos.begin(), blockedPos.end());
+	changedTiles.push_back(obj->visitablePos());
+	cl->invalidatePaths(changedTiles);
 	CGI->mh->printObject(obj, true);
 
 	for(auto i=cl->playerint.begin(); i!=cl->playerint.end(); i++)
@@ -11,6 +11,54 @@
  *
  */
 
+namespace
+{
+	char calculateDistance(BattleHex hex1, BattleHex hex2)
+	{
+		int y1 = hex1.getY(),
+			y2 = hex2.getY();
+
+		// FIXME: Omit floating point arithmetics
+		int x1 = (int)(hex1.getX() + y1 * 0.5),
+			x2 = (int)(hex2.getX() + y2 * 0.5);
+
+		int xDst = x2 - x1,
+			yDst = y2 - y1;
+
+		if ((xDst >= 0 && yDst >= 0) || (xDst < 0 && yDst < 0))
+			return std::max(std::abs(xDst), std::abs(yDst));
+
+		return std::abs(xDst) + std::abs(yDst);
+	}
+
+	/// Neighbours and distances for all hexes of the battlefield, used by every BFS step and AI loop
+	struct BattleHexTables
+	{
+		std::array<BattleHexNeighbours, GameConstants::BFIELD_SIZE> neighbours;
+		std::array<std::array<char, GameConstants::BFIELD_SIZE>, GameConstants::BFIELD_SIZE> distances;
+
+		BattleHexTables()
+		{
+			for(si16 hex = 0; hex < GameConstants::BFIELD_SIZE; hex++)
+			{
+				auto tiles = BattleHex(hex).neighbouringTiles();
+				assert(tiles.size() <= neighbours[hex].tiles.size());
+				std::copy(tiles.begin(), tiles.end(), neighbours[hex].tiles.begin());
+				neighbours[hex].count = tiles.size();
+
+				for(si16 other = 0; other < GameConstants::BFIELD_SIZE; other++)
+					distances[hex][other] = calculateDistance(hex, other);
+			}
+		}
+	};
+
+	const BattleHexTables & getTables()
+	{
+		static const BattleHexTables tables;
+		return tables;
+	}
+}
+
 BattleHex& BattleHex::moveInDir(EDir dir, bool hasToBeValid)
 {
 	si16 x = getX(),
@@ -60,6 +108,12 @@ std::vector<BattleHex> BattleHex::neighbouringTiles() const
 	return ret;
 }
 
+const BattleHexNeighbours & BattleHex::neighbouringTilesView() const
+{
+	static const BattleHexNeighbours none;
+	return isValid() ? getTables().neighbours[hex] : none;
+}
+
 signed char BattleHex::mutualPosition(BattleHex hex1, BattleHex hex2)
 {
 	if(hex2 == hex1 - ( (hex1/17)%2 ? 18 : 17 )) //top left
@@ -78,21 +132,12 @@ signed char BattleHex::mutualPosition(BattleHex hex1, BattleHex hex2)
 }
 
 char BattleHex::getDistance(BattleHex hex1, BattleHex hex2)
-{	
-	int y1 = hex1.getY(), 
-		y2 = hex2.getY();
-	
-	// FIXME: Omit floating point arithmetics
-	int x1 = (int)(hex1.getX() + y1 * 0.5),
-		x2 = (int)(hex2.getX() + y2 * 0.5);
-
-	int xDst = x2 - x1,
-		yDst = y2 - y1;
-
-	if ((xDst >= 0 && yDst >= 0) || (xDst < 0 && yDst < 0)) 
-		return std::max(std::abs(xDst), std::abs(yDst));
-	
-	return std::abs(xDst) + std::abs(yDst);
+{
+	//turrets and invalid hexes are outside the table
+	if(hex1.isValid() && hex2.isValid())
+		return getTables().distances[hex1][hex2];
+
+	return calculateDistance(hex1, hex2);
 }
 
 void BattleHex::checkAndPush(BattleHex tile, std::vector<BattleHex> & ret)
@@ -2,7 +2,6 @@
 
 #include "GameConstants.h"
 
-
 /*
  * BattleHex.h, part of VCMI engine
  *
@@ -13,6 +12,8 @@
  *
  */
 
+struct BattleHexNeighbours;
+
 // for battle stacks' positions
 struct DLL_LINKAGE BattleHex
 {
@@ -84,11 +85,13 @@ struct DLL_LINKAGE BattleHex
 	BattleHex operator+(EDir dir) const { return movedInDir(dir); }
 
 	std::vector<BattleHex> neighbouringTiles() const;
+	//same tiles as above, but taken from precomputed table without allocating; empty for hexes outside battlefield
+	const BattleHexNeighbours & neighbouringTilesView() const;
 
 	//returns info about mutual position of given hexes (-1 - they're distant, 0 - left top, 1 - right top, 2 - right, 3 - right bottom, 4 - left bottom, 5 - left)
 	static signed char mutualPosition(BattleHex hex1, BattleHex hex2);
 
-	//returns distance between given hexes
+	//returns distance between given hexes, precomputed for all pairs of hexes on battlefield
 	static char getDistance(BattleHex hex1, BattleHex hex2);
 
 	template <typename Handler> void serialize(Handler &h, const int version)
@@ -101,4 +104,19 @@ struct DLL_LINKAGE BattleHex
 	static BattleHex getClosestTile(bool attackerOwned, BattleHex initialPos, std::set<BattleHex> & possibilities); //TODO: vector or set? copying one to another is bad
 };
 
+/// Available neighbours of a hex in H3 order (TR, R, BR, BL, L, TL), stored in place and iterable like a container
+struct DLL_LINKAGE BattleHexNeighbours
+{
+	std::array<BattleHex, 6> tiles;
+	ui8 count;
+
+	BattleHexNeighbours() : count(0) {}
+
+	const BattleHex * begin() const { return tiles.data(); }
+	const BattleHex * end() const { return tiles.data() + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	BattleHex operator[](size_t index) const { return tiles[index]; }
+};
+
 DLL_EXPORT std::ostream & operator<<(std::ostream & os, const BattleHex & hex);
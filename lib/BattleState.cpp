@@ -148,6 +148,11 @@ CStack * BattleInfo::generateNewStack(const CStackBasicDescriptor &base, bool at
 	return ret;
 }
 
+void BattleInfo::stateChanged()
+{
+	stateVersion++;
+}
+
 void BattleInfo::localInit()
 {
 	for(int i = 0; i < 2; i++)
@@ -491,6 +496,7 @@ BattleInfo * BattleInfo::setupBattle( int3 tile, ETerrainType terrain, BFieldTyp
 
 			CStack * stack = curB->generateNewStack(*i->second, !side, i->first, pos);
 			stacks.push_back(stack);
+			curB->stateChanged(); //next stack is placed around this one
 		}
 	}
 
@@ -727,7 +733,7 @@ CStack * BattleInfo::getStack(int stackID, bool onlyAlive /*= true*/)
 BattleInfo::BattleInfo()
 	: round(-1), activeStack(-1), selectedStack(-1), town(nullptr), tile(-1,-1,-1),
 	battlefieldType(BFieldType::NONE), terrainType(ETerrainType::WRONG),
-	tacticsSide(0), tacticDistance(0)
+	tacticsSide(0), tacticDistance(0), stateVersion(0)
 {
 	setBattle(this);
 	setNodeType(BATTLE);
@@ -856,6 +862,9 @@ bool CStack::willMove(int turn /*= 0*/) const
 
 bool CStack::canMove( int turn /*= 0*/ ) const
 {
+	if(turn <= 0) //every effect lasts zero turns, no need for turn selector
+		return alive() && !hasBonusOfType(Bonus::NOT_ACTIVE);
+
 	return alive()
 		&& !hasBonus(Selector::type(Bonus::NOT_ACTIVE).And(Selector::turns(turn))); //eg. Ammo Cart or blinded creature
 }
@@ -973,15 +982,14 @@ std::vector<si32> CStack::activeSpells() const
 {
 	std::vector<si32> ret;
 
-	std::stringstream cachingStr;
-	cachingStr << "!type_" << Bonus::NONE << "source_" << Bonus::SPELL_EFFECT;
-	CSelector selector = Selector::sourceType(Bonus::SPELL_EFFECT)
+	static const std::string cachingStr = boost::str(boost::format("!type_%dsource_%d") % Bonus::NONE % Bonus::SPELL_EFFECT);
+	static const CSelector selector = Selector::sourceType(Bonus::SPELL_EFFECT)
 		.And(CSelector([](const Bonus *b)->bool
 		{
 			return b->type != Bonus::NONE;
 		}));
 
-	TBonusListPtr spellEffects = getBonuses(selector, Selector::all, cachingStr.str());
+	TBonusListPtr spellEffects = getBonuses(selector, Selector::all, cachingStr);
 	for(const std::shared_ptr<Bonus> it : *spellEffects)
 	{
 		if (!vstd::contains(ret, it->sid)) //do not duplicate spells with multiple effects
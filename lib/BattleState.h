@@ -95,6 +95,9 @@ struct DLL_LINKAGE BattleInfo : public CBonusSystemNode, public CBattleInfoCallb
 	ui8 tacticsSide; //which side is requested to play tactics phase
 	ui8 tacticDistance; //how many hexes we can go forward (1 = only hexes adjacent to margin line)
 
+	ui32 stateVersion; //changed whenever accessibility of hexes may change; not serialized
+	mutable BattleReachabilityCache reachabilityCache;
+
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
 		h & sides;
@@ -115,6 +118,7 @@ struct DLL_LINKAGE BattleInfo : public CBonusSystemNode, public CBattleInfoCallb
 	using CBattleInfoEssentials::battleGetFightingHero;
 	CGHeroInstance * battleGetFightingHero(ui8 side) const;
 
+	void stateChanged(); //stacks moved, died or appeared, obstacles or walls changed -> drops cached accessibility and reachability
 	const CStack * getNextStack() const; //which stack will have turn after current one
 	//void getStackQueue(std::vector<const CStack *> &out, int howMany, int turn = 0, int lastMoved = -1) const; //returns stack in order of their movement action
 
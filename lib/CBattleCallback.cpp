@@ -347,6 +347,16 @@ const IBonusBearer * CBattleInfoEssentials::getBattleNode() const
 	return getBattle();
 }
 
+BattleReachabilityCache & CBattleInfoEssentials::battleGetReachabilityCache() const
+{
+	return getBattle()->reachabilityCache;
+}
+
+ui32 CBattleInfoEssentials::battleGetStateVersion() const
+{
+	return getBattle()->stateVersion;
+}
+
 ESpellCastProblem::ESpellCastProblem CBattleInfoCallback::battleCanCastSpell(const ISpellCaster * caster, ECastingMode::ECastingMode mode) const
 {
 	RETURN_IF_NOT_BATTLE(ESpellCastProblem::INVALID);
@@ -777,34 +787,14 @@ std::vector<BattleHex> CBattleInfoCallback::battleGetAvailableHexes(const CStack
 	if(!stack->position.isValid()) //turrets
 		return ret;
 
-	auto reachability = getReachability(stack);
+	ret = battleGetAvailableHexes(stack, getReachability(stack), stack->Speed(0, true));
 
-	for (int i = 0; i < GameConstants::BFIELD_SIZE; ++i)
+	if(addOccupiable && stack->doubleWide())
 	{
-		// If obstacles or other stacks makes movement impossible, it can't be helped.
-		if(!reachability.isReachable(i))
-			continue;
-
-		if(battleTacticDist() && battleGetTacticsSide() == !stack->attackerOwned)
-		{
-			//Stack has to perform tactic-phase movement -> can enter any reachable tile within given range
-			if(!isInTacticRange(i))
-				continue;
-		}
-		else
-		{
-			//Not tactics phase -> destination must be reachable and within stack range.
-			if(reachability.distances[i] > stack->Speed(0, true))
-				continue;
-		}
-
-		ret.push_back(i);
-
-		if(addOccupiable && stack->doubleWide())
-		{
-			//If two-hex stack can stand on hex i then obviously it can occupy its second hex from that position
-			ret.push_back(stack->occupiedHex(i));
-		}
+		//If two-hex stack can stand on hex i then obviously it can occupy its second hex from that position
+		const size_t destinations = ret.size();
+		for(size_t i = 0; i < destinations; i++)
+			ret.push_back(stack->occupiedHex(ret[i]));
 	}
 
 
@@ -847,6 +837,35 @@ std::vector<BattleHex> CBattleInfoCallback::battleGetAvailableHexes(const CStack
 	return ret;
 }
 
+std::vector<BattleHex> CBattleInfoCallback::battleGetAvailableHexes(const CStack * stack, const ReachabilityInfo & reachability, int speed) const
+{
+	std::vector<BattleHex> ret;
+	RETURN_IF_NOT_BATTLE(ret);
+
+	for (int i = 0; i < GameConstants::BFIELD_SIZE; ++i)
+	{
+		// If obstacles or other stacks makes movement impossible, it can't be helped.
+		if(!reachability.isReachable(i))
+			continue;
+
+		if(battleTacticDist() && battleGetTacticsSide() == !stack->attackerOwned)
+		{
+			//Stack has to perform tactic-phase movement -> can enter any reachable tile within given range
+			if(!isInTacticRange(i))
+				continue;
+		}
+		else
+		{
+			//Not tactics phase -> destination must be reachable and within stack range.
+			if(reachability.distances[i] > speed)
+				continue;
+		}
+
+		ret.push_back(i);
+	}
+	return ret;
+}
+
 bool CBattleInfoCallback::battleCanAttack(const CStack * stack, const CStack * target, BattleHex dest) const
 {
 	RETURN_IF_NOT_BATTLE(false);
@@ -874,16 +893,26 @@ bool CBattleInfoCallback::battleCanShoot(const CStack * stack, BattleHex dest) c
 {
 	RETURN_IF_NOT_BATTLE(false);
 
-	if(battleTacticDist()) //no shooting during tactics
-		return false;
-
 	const CStack *dst = battleGetStackByPos(dest);
 
 	if(!stack || !dst)
 		return false;
 
+	if(!battleMatchOwner(stack, dst) || !dst->alive())
+		return false;
+
+	return battleCanShoot(stack, stack, stack->shots, battleIsStackBlocked(stack));
+}
+
+bool CBattleInfoCallback::battleCanShoot(const CStack * stack, const IBonusBearer * bonuses, si16 shots, bool blocked) const
+{
+	RETURN_IF_NOT_BATTLE(false);
+
+	if(battleTacticDist()) //no shooting during tactics
+		return false;
+
 	//forgetfulness
-	TBonusListPtr forgetfulList = stack->getBonuses(Selector::type(Bonus::FORGETFULL),"");
+	TBonusListPtr forgetfulList = bonuses->getBonuses(Selector::type(Bonus::FORGETFULL),"");
 	if(!forgetfulList->empty())
 	{
 		int forgetful = forgetfulList->valOfBonuses(Selector::type(Bonus::FORGETFULL));
@@ -893,17 +922,12 @@ bool CBattleInfoCallback::battleCanShoot(const CStack * stack, BattleHex dest) c
 			return false;
 	}
 
-	if(stack->getCreature()->idNumber == CreatureID::CATAPULT && dst) //catapult cannot attack creatures
+	if(stack->getCreature()->idNumber == CreatureID::CATAPULT) //catapult cannot attack creatures
 		return false;
 
-	if(stack->hasBonusOfType(Bonus::SHOOTER)//it's shooter
-		&& battleMatchOwner(stack, dst)
-		&& dst->alive()
-		&& (!battleIsStackBlocked(stack)  ||  stack->hasBonusOfType(Bonus::FREE_SHOOTING))
-		&& stack->shots
-		)
-		return true;
-	return false;
+	return bonuses->hasBonusOfType(Bonus::SHOOTER) //it's shooter
+		&& (!blocked || bonuses->hasBonusOfType(Bonus::FREE_SHOOTING))
+		&& shots;
 }
 
 TDmgRange CBattleInfoCallback::calculateDmgRange(const CStack* attacker, const CStack* defender, bool shooting,
@@ -1215,6 +1239,31 @@ std::shared_ptr<const CObstacleInstance> CBattleInfoCallback::battleGetObstacleO
 }
 
 AccessibilityInfo CBattleInfoCallback::getAccesibility() const
+{
+	if(!duringBattle())
+		return calculateAccesibility();
+
+	//obstacles visible for our side only
+	const auto perspective = battleGetMySide();
+	const ui32 version = battleGetStateVersion();
+	auto & cache = battleGetReachabilityCache();
+	{
+		boost::unique_lock<boost::mutex> lock(cache.mx);
+		cache.update(version);
+		auto it = cache.accessibility.find(perspective);
+		if(it != cache.accessibility.end())
+			return it->second;
+	}
+
+	auto ret = calculateAccesibility();
+
+	boost::unique_lock<boost::mutex> lock(cache.mx);
+	if(cache.version == version && battleGetStateVersion() == version)
+		cache.accessibility[perspective] = ret;
+	return ret;
+}
+
+AccessibilityInfo CBattleInfoCallback::calculateAccesibility() const
 {
 	AccessibilityInfo ret;
 	ret.fill(EAccessibility::ACCESSIBLE);
@@ -1333,7 +1382,7 @@ ReachabilityInfo CBattleInfoCallback::makeBFS(const AccessibilityInfo &accessibi
 			continue;
 
 		const int costToNeighbour = ret.distances[curHex] + 1;
-		for(BattleHex neighbour : curHex.neighbouringTiles())
+		for(BattleHex neighbour : curHex.neighbouringTilesView())
 		{
 			const bool accessible = accessibility.accessible(neighbour, params.doubleWide, params.attackerOwned);
 			const int costFoundSoFar = ret.distances[neighbour];
@@ -1445,17 +1494,53 @@ ReachabilityInfo CBattleInfoCallback::getReachability(const CStack *stack) const
 }
 
 ReachabilityInfo CBattleInfoCallback::getReachability(const ReachabilityInfo::Parameters &params) const
+{
+	//only stack standing at its own position is cached, hypothetical positions are rarely asked for twice
+	const CStack * stack = params.stack;
+	if(!duringBattle() || !stack || params.startPosition != stack->position || params.knownAccessible != stack->getHexes())
+		return calculateReachability(params);
+
+	const auto key = std::make_tuple(stack->ID, battleGetMySide(), params.perspective);
+	const ui32 version = battleGetStateVersion();
+	auto & cache = battleGetReachabilityCache();
+	{
+		boost::unique_lock<boost::mutex> lock(cache.mx);
+		cache.update(version);
+		auto it = cache.reachability.find(key);
+		//flying may be granted or taken by spells without changing battle state
+		if(it != cache.reachability.end() && it->second.params.flying == params.flying
+			&& it->second.params.doubleWide == params.doubleWide && it->second.params.attackerOwned == params.attackerOwned)
+		{
+			return it->second;
+		}
+	}
+
+	auto ret = calculateReachability(params);
+
+	boost::unique_lock<boost::mutex> lock(cache.mx);
+	if(cache.version == version && battleGetStateVersion() == version)
+		cache.reachability[key] = ret;
+	return ret;
+}
+
+ReachabilityInfo CBattleInfoCallback::getReachability(const AccessibilityInfo &accessibility, const ReachabilityInfo::Parameters &params) const
 {
 	if(params.flying)
-		return getFlyingReachability(params);
+		return getFlyingReachability(accessibility, params);
 	else
-		return makeBFS(getAccesibility(params.knownAccessible), params);
+		return makeBFS(accessibility, params);
+}
+
+ReachabilityInfo CBattleInfoCallback::calculateReachability(const ReachabilityInfo::Parameters &params) const
+{
+	return getReachability(getAccesibility(params.knownAccessible), params);
 }
 
-ReachabilityInfo CBattleInfoCallback::getFlyingReachability(const ReachabilityInfo::Parameters &params) const
+ReachabilityInfo CBattleInfoCallback::getFlyingReachability(const AccessibilityInfo &accessibility, const ReachabilityInfo::Parameters &params) const
 {
 	ReachabilityInfo ret;
-	ret.accessibility = getAccesibility(params.knownAccessible);
+	ret.accessibility = accessibility;
+	ret.params = params;
 
 	for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
 	{
@@ -1823,12 +1908,18 @@ bool CBattleInfoCallback::battleIsStackBlocked(const CStack * stack) const
 
 	for(const CStack * s :  batteAdjacentCreatures(stack))
 	{
-		if (s->owner != stack->owner) //blocked by enemy stack
+		if(battleIsStackBlockedBy(stack, stack, s))
 			return true;
 	}
 	return false;
 }
 
+bool CBattleInfoCallback::battleIsStackBlockedBy(const CStack * stack, const IBonusBearer * bonuses, const CStack * neighbour)
+{
+	return neighbour && neighbour->owner != stack->owner //blocked by enemy stack
+		&& !bonuses->hasBonusOfType(Bonus::SIEGE_WEAPON); //siege weapons cannot be blocked
+}
+
 std::set<const CStack*> CBattleInfoCallback:: batteAdjacentCreatures(const CStack * stack) const
 {
 	std::set<const CStack*> stacks;
@@ -2052,21 +2143,31 @@ boost::optional<int> CBattleInfoCallback::battleIsFinished() const
 
 	for(auto & stack : stacks)
 	{
-		if(stack->alive() && !stack->hasBonusOfType(Bonus::SIEGE_WEAPON))
+		if(stack->alive() && battleKeepsSideFighting(stack))
 		{
 			hasStack[1-stack->attackerOwned] = true;
 		}
 	}
 
-	if(!hasStack[0] && !hasStack[1])
+	return battleIsFinished(hasStack[0], hasStack[1]);
+}
+
+boost::optional<int> CBattleInfoCallback::battleIsFinished(bool attackerHasStacks, bool defenderHasStacks)
+{
+	if(!attackerHasStacks && !defenderHasStacks)
 		return 2;
-	if(!hasStack[1])
+	if(!defenderHasStacks)
 		return 0;
-	if(!hasStack[0])
+	if(!attackerHasStacks)
 		return 1;
 	return boost::none;
 }
 
+bool CBattleInfoCallback::battleKeepsSideFighting(const IBonusBearer * stack)
+{
+	return !stack->hasBonusOfType(Bonus::SIEGE_WEAPON);
+}
+
 bool AccessibilityInfo::accessible(BattleHex tile, const CStack *stack) const
 {
 	return accessible(tile, stack->doubleWide(), stack->attackerOwned);
@@ -2108,6 +2209,21 @@ bool AccessibilityInfo::occupiable(const CStack *stack, BattleHex tile) const
 	return false;
 }
 
+BattleReachabilityCache::BattleReachabilityCache()
+	: version(0)
+{
+}
+
+void BattleReachabilityCache::update(ui32 currentVersion)
+{
+	if(version == currentVersion)
+		return;
+
+	version = currentVersion;
+	accessibility.clear();
+	reachability.clear();
+}
+
 ReachabilityInfo::Parameters::Parameters()
 {
 	stack = nullptr;
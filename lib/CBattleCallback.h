@@ -156,11 +156,26 @@ struct DLL_LINKAGE ReachabilityInfo
 	}
 };
 
+/// Accessibility and reachability computed for one state of the battle, shared by all callbacks of that battle.
+/// Results are dropped when BattleInfo::stateVersion changes, that is when stacks move, die or appear or when obstacles or walls change.
+struct DLL_LINKAGE BattleReachabilityCache
+{
+	boost::mutex mx;
+	ui32 version; //BattleInfo::stateVersion the results are valid for
+	std::map<BattlePerspective::BattlePerspective, AccessibilityInfo> accessibility; //by perspective of callback
+	std::map<std::tuple<ui32, BattlePerspective::BattlePerspective, BattlePerspective::BattlePerspective>, ReachabilityInfo> reachability; //by stack ID, perspective of callback and of stack; only for stack at its position
+
+	BattleReachabilityCache();
+	void update(ui32 currentVersion); //drops results of other battle state, mx has to be locked
+};
+
 class DLL_LINKAGE CBattleInfoEssentials : public virtual CCallbackBase
 {
 protected:
 	bool battleDoWeKnowAbout(ui8 side) const;
 	const IBonusBearer * getBattleNode() const;
+	BattleReachabilityCache & battleGetReachabilityCache() const;
+	ui32 battleGetStateVersion() const;
 public:
 	enum EStackOwnership
 	{
@@ -254,6 +269,8 @@ public:
 
 	//battle
 	boost::optional<int> battleIsFinished() const; //return none if battle is ongoing; otherwise the victorious side (0/1) or 2 if it is a draw
+	static boost::optional<int> battleIsFinished(bool attackerHasStacks, bool defenderHasStacks); //same result for given presence of stacks counted by battleKeepsSideFighting
+	static bool battleKeepsSideFighting(const IBonusBearer * stack); //alive stack with these bonuses prevents defeat of its side
 
 	std::shared_ptr<const CObstacleInstance> battleGetObstacleOnPos(BattleHex tile, bool onlyBlocking = true) const; //blocking obstacles makes tile inaccessible, others cause special effects (like Land Mines, Moat, Quicksands)
 	const CStack * battleGetStackByPos(BattleHex pos, bool onlyAlive = true) const; //returns stack info by given pos
@@ -262,6 +279,7 @@ public:
 
 
 	std::vector<BattleHex> battleGetAvailableHexes(const CStack * stack, bool addOccupiable, std::vector<BattleHex> * attackable = nullptr) const; //returns hexes reachable by creature with id ID (valid movement destinations), DOES contain stack current position
+	std::vector<BattleHex> battleGetAvailableHexes(const CStack * stack, const ReachabilityInfo & reachability, int speed) const; //movement destinations for given reachability and speed of stack, like in hypothetical battle state
 
 	int battleGetSurrenderCost(PlayerColor Player) const; //returns cost of surrendering battle, -1 if surrendering is not possible
 	ReachabilityInfo::TDistances battleGetDistances(const CStack * stack, BattleHex hex = BattleHex::INVALID, BattleHex * predecessors = nullptr) const; //returns vector of distances to [dest hex number]
@@ -269,7 +287,9 @@ public:
 
 	bool battleCanAttack(const CStack * stack, const CStack * target, BattleHex dest) const; //determines if stack with given ID can attack target at the selected destination
 	bool battleCanShoot(const CStack * stack, BattleHex dest) const; //determines if stack with given ID shoot at the selected destination
+	bool battleCanShoot(const CStack * stack, const IBonusBearer * bonuses, si16 shots, bool blocked) const; //shooter rules for stack in given state, target has to be checked by caller
 	bool battleIsStackBlocked(const CStack * stack) const; //returns true if there is neighboring enemy stack
+	static bool battleIsStackBlockedBy(const CStack * stack, const IBonusBearer * bonuses, const CStack * neighbour); //neighbour is enemy able to block stack with these bonuses
 	std::set<const CStack*>  batteAdjacentCreatures (const CStack * stack) const;
 
 	TDmgRange calculateDmgRange(const BattleAttackInfo &info) const; //charge - number of hexes travelled before attack (for champion's jousting); returns pair <min dmg, max dmg>
@@ -320,12 +340,15 @@ public:
 
 	ReachabilityInfo getReachability(const CStack *stack) const;
 	ReachabilityInfo getReachability(const ReachabilityInfo::Parameters &params) const;
+	ReachabilityInfo getReachability(const AccessibilityInfo &accessibility, const ReachabilityInfo::Parameters &params) const; //for hypothetical placement of stacks given by accessibility, not cached
 	AccessibilityInfo getAccesibility() const;
 	AccessibilityInfo getAccesibility(const CStack *stack) const; //Hexes ocupied by stack will be marked as accessible.
 	AccessibilityInfo getAccesibility(const std::vector<BattleHex> &accessibleHexes) const; //given hexes will be marked as accessible
 	std::pair<const CStack *, BattleHex> getNearestStack(const CStack * closest, boost::logic::tribool attackerOwned) const;
 protected:
-	ReachabilityInfo getFlyingReachability(const ReachabilityInfo::Parameters &params) const;
+	AccessibilityInfo calculateAccesibility() const;
+	ReachabilityInfo calculateReachability(const ReachabilityInfo::Parameters &params) const;
+	ReachabilityInfo getFlyingReachability(const AccessibilityInfo &accessibility, const ReachabilityInfo::Parameters &params) const;
 	ReachabilityInfo makeBFS(const AccessibilityInfo &accessibility, const ReachabilityInfo::Parameters &params) const;
 	ReachabilityInfo makeBFS(const CStack *stack) const; //uses default parameters -> stack position and owner's perspective
 	std::set<BattleHex> getStoppers(BattlePerspective::BattlePerspective whichSidePerspective) const; //get hexes with stopping obstacles (quicksands)
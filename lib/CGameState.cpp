@@ -23,9 +23,11 @@
 #include "GameConstants.h"
 #include "rmg/CMapGenerator.h"
 #include "CStopWatch.h"
+#include "CThreadPool.h"
 #include "mapping/CMapEditManager.h"
 #include "serializer/CTypeList.h"
 #include "serializer/CMemorySerializer.h"
+#include "serializer/CGameStateSnapshots.h"
 
 #ifdef min
 #undef min
@@ -650,6 +652,7 @@ CGameState::CGameState()
 {
 	gs = this;
 	mx = new boost::shared_mutex();
+	snapshots = make_unique<CGameStateSnapshots>(this);
 	applierGs = new CApplier<CBaseForGSApply>;
 	registerTypesClientPacks1(*applierGs);
 	registerTypesClientPacks2(*applierGs);
@@ -877,28 +880,10 @@ void CGameState::initDuel()
 			if(count || obj->hasStackAtSlot(SlotID(j)))
 				obj->setCreature(SlotID(j), cre, count);
 		}
-
-		for(const DuelParameters::CusomCreature &cc : dp.creatures)
-		{
-			CCreature *c = VLC->creh->creatures[cc.id];
-			if(cc.attack >= 0)
-				c->getBonusLocalFirst(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK))->val = cc.attack;
-			if(cc.defense >= 0)
-				c->getBonusLocalFirst(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::DEFENSE))->val = cc.defense;
-			if(cc.speed >= 0)
-				c->getBonusLocalFirst(Selector::type(Bonus::STACKS_SPEED))->val = cc.speed;
-			if(cc.HP >= 0)
-				c->getBonusLocalFirst(Selector::type(Bonus::STACK_HEALTH))->val = cc.HP;
-			if(cc.dmg >= 0)
-			{
-				c->getBonusLocalFirst(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 1))->val = cc.dmg;
-				c->getBonusLocalFirst(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 2))->val = cc.dmg;
-			}
-			if(cc.shoots >= 0)
-				c->getBonusLocalFirst(Selector::type(Bonus::SHOTS))->val = cc.shoots;
-		}
 	}
 
+	dp.applyCustomCreatures();
+
 	curB = BattleInfo::setupBattle(int3(-1,-1,-1), dp.terType, dp.bfieldType, armies, heroes, false, town);
 	curB->obstacles = dp.obstacles;
 	curB->localInit();
@@ -2005,6 +1990,7 @@ PlayerRelations::PlayerRelations CGameState::getPlayerRelations( PlayerColor col
 void CGameState::apply(CPack *pack)
 {
 	ui16 typ = typeList.getTypeID(pack);
+	snapshots->record(pack);
 	applierGs->getApplier(typ)->applyOnGS(this,pack);
 }
 
@@ -2014,6 +2000,47 @@ void CGameState::calculatePaths(const CGHeroInstance *hero, CPathsInfo &out)
 	pathfinder.calculatePaths();
 }
 
+void CGameState::updatePaths(const CGHeroInstance *hero, CPathsInfo &out, const std::vector<int3> & changedTiles)
+{
+	CPathfinder pathfinder(out, this, hero);
+	pathfinder.updatePaths(changedTiles);
+}
+
+void CGameState::calculatePaths(const std::vector<std::pair<const CGHeroInstance *, CPathsInfo *>> & jobs)
+{
+	if(jobs.size() == 1)
+	{
+		boost::unique_lock<boost::mutex> pathLock(jobs.front().second->pathMx);
+		calculatePaths(jobs.front().first, *jobs.front().second);
+		return;
+	}
+
+	//shared graphs are brought up to date first, tasks only read them
+	std::set<const CPathsGraph *> updatedGraphs;
+	for(auto & job : jobs)
+	{
+		CPathsGraph * graph = job.second->graph;
+		if(graph && updatedGraphs.insert(graph).second)
+		{
+			CPathfinder pathfinder(*job.second, this, job.first);
+			pathfinder.updateGraph(*graph);
+		}
+	}
+
+	//every task owns its pathfinder (and so helper and turn info), only game state and graphs are shared and read
+	CThreadPool::TaskGroup group;
+	for(auto & job : jobs)
+	{
+		group.run([this, job]()
+		{
+			boost::unique_lock<boost::mutex> pathLock(job.second->pathMx);
+			CPathfinder pathfinder(*job.second, this, job.first);
+			pathfinder.calculatePathsWithUpdatedGraph();
+		});
+	}
+	group.wait();
+}
+
 /**
  * Tells if the tile is guarded by a monster as well as the position
  * of the monster that will attack on it.
@@ -3109,10 +3136,14 @@ DuelParameters::DuelParameters():
 }
 
 DuelParameters DuelParameters::fromJSON(const std::string &fname)
+{
+	return fromJSON(JsonNode(ResourceID("DATA/" + fname, EResType::TEXT)));
+}
+
+DuelParameters DuelParameters::fromJSON(const JsonNode &duelData)
 {
 	DuelParameters ret;
 
-	const JsonNode duelData(ResourceID("DATA/" + fname, EResType::TEXT));
 	ret.terType = ETerrainType((int)duelData["terType"].Float());
 	ret.bfieldType = BFieldType((int)duelData["bfieldType"].Float());
 	for(const JsonNode &n : duelData["sides"].Vector())
@@ -3200,6 +3231,29 @@ DuelParameters DuelParameters::fromJSON(const std::string &fname)
 	return ret;
 }
 
+void DuelParameters::applyCustomCreatures() const
+{
+	for(const CusomCreature &cc : creatures)
+	{
+		CCreature *c = VLC->creh->creatures[cc.id];
+		if(cc.attack >= 0)
+			c->getBonusLocalFirst(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK))->val = cc.attack;
+		if(cc.defense >= 0)
+			c->getBonusLocalFirst(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::DEFENSE))->val = cc.defense;
+		if(cc.speed >= 0)
+			c->getBonusLocalFirst(Selector::type(Bonus::STACKS_SPEED))->val = cc.speed;
+		if(cc.HP >= 0)
+			c->getBonusLocalFirst(Selector::type(Bonus::STACK_HEALTH))->val = cc.HP;
+		if(cc.dmg >= 0)
+		{
+			c->getBonusLocalFirst(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 1))->val = cc.dmg;
+			c->getBonusLocalFirst(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 2))->val = cc.dmg;
+		}
+		if(cc.shoots >= 0)
+			c->getBonusLocalFirst(Selector::type(Bonus::SHOTS))->val = cc.shoots;
+	}
+}
+
 TeamState::TeamState()
 {
 	setNodeType(TEAM);
@@ -56,6 +56,8 @@ class CQuest;
 class CCampaignScenario;
 struct EventCondition;
 class CScenarioTravel;
+class CGameStateSnapshots;
+class JsonNode;
 
 namespace boost
 {
@@ -152,6 +154,7 @@ struct DLL_EXPORT DuelParameters
 	std::vector<std::shared_ptr<CObstacleInstance> > obstacles;
 
 	static DuelParameters fromJSON(const std::string &fname);
+	static DuelParameters fromJSON(const JsonNode &duelData);
 
 	struct CusomCreature
 	{
@@ -170,6 +173,8 @@ struct DLL_EXPORT DuelParameters
 
 	std::vector<CusomCreature> creatures;
 
+	void applyCustomCreatures() const; //changes stats of creature types, for all battles since then
+
 	DuelParameters();
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
@@ -214,6 +219,7 @@ public:
 	RumorState rumor;
 
 	boost::shared_mutex *mx;
+	std::unique_ptr<CGameStateSnapshots> snapshots; //journal of applied packs for delta savegames
 
 	void giveHeroArtifact(CGHeroInstance *h, ArtifactID aid);
 
@@ -223,6 +229,10 @@ public:
 	PlayerRelations::PlayerRelations getPlayerRelations(PlayerColor color1, PlayerColor color2);
 	bool checkForVisitableDir(const int3 & src, const int3 & dst) const; //check if src tile is visitable from dst tile
 	void calculatePaths(const CGHeroInstance *hero, CPathsInfo &out); //calculates possible paths for hero, by default uses current hero position and movement left; returns pointer to newly allocated CPath or nullptr if path does not exists
+	void updatePaths(const CGHeroInstance *hero, CPathsInfo &out, const std::vector<int3> & changedTiles); //updates paths calculated before for the same hero after given tiles changed
+	/// Calculates paths for several heroes at once, each hero on its own worker thread.
+	/// Game state is only read, caller must make sure it won't be modified until this returns (e.g. by holding mx).
+	void calculatePaths(const std::vector<std::pair<const CGHeroInstance *, CPathsInfo *>> & jobs);
 	int3 guardingCreaturePosition (int3 pos) const;
 	std::vector<CGObjectInstance*> guardingCreatures (int3 pos) const;
 	void updateRumor();
@@ -22,23 +22,26 @@
 
 CPathfinder::PathfinderOptions::PathfinderOptions()
 {
-	useFlying = settings["pathfinder"]["layers"]["flying"].Bool();
-	useWaterWalking = settings["pathfinder"]["layers"]["waterWalking"].Bool();
-	useEmbarkAndDisembark = settings["pathfinder"]["layers"]["sailing"].Bool();
-	useTeleportTwoWay = settings["pathfinder"]["teleports"]["twoWay"].Bool();
-	useTeleportOneWay = settings["pathfinder"]["teleports"]["oneWay"].Bool();
-	useTeleportOneWayRandom = settings["pathfinder"]["teleports"]["oneWayRandom"].Bool();
-	useTeleportWhirlpool = settings["pathfinder"]["teleports"]["whirlpool"].Bool();
-
-	useCastleGate = settings["pathfinder"]["teleports"]["castleGate"].Bool();
-
-	lightweightFlyingMode = settings["pathfinder"]["lightweightFlyingMode"].Bool();
-	oneTurnSpecialLayersLimit = settings["pathfinder"]["oneTurnSpecialLayersLimit"].Bool();
-	originalMovementRules = settings["pathfinder"]["originalMovementRules"].Bool();
+	//const access only, pathfinders for several heroes may be created concurrently
+	const JsonNode & config = settings["pathfinder"];
+
+	useFlying = config["layers"]["flying"].Bool();
+	useWaterWalking = config["layers"]["waterWalking"].Bool();
+	useEmbarkAndDisembark = config["layers"]["sailing"].Bool();
+	useTeleportTwoWay = config["teleports"]["twoWay"].Bool();
+	useTeleportOneWay = config["teleports"]["oneWay"].Bool();
+	useTeleportOneWayRandom = config["teleports"]["oneWayRandom"].Bool();
+	useTeleportWhirlpool = config["teleports"]["whirlpool"].Bool();
+
+	useCastleGate = config["teleports"]["castleGate"].Bool();
+
+	lightweightFlyingMode = config["lightweightFlyingMode"].Bool();
+	oneTurnSpecialLayersLimit = config["oneTurnSpecialLayersLimit"].Bool();
+	originalMovementRules = config["originalMovementRules"].Bool();
 }
 
 CPathfinder::CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstance * _hero)
-	: CGameInfoCallback(_gs, boost::optional<PlayerColor>()), out(_out), hero(_hero), FoW(getPlayerTeam(hero->tempOwner)->fogOfWarMap), patrolTiles({})
+	: CGameInfoCallback(_gs, boost::optional<PlayerColor>()), out(_out), hero(_hero), FoW(getPlayerTeam(hero->tempOwner)->fogOfWarMap), patrolTiles({}), repairing(false)
 {
 	assert(hero);
 	assert(hero == getHero(hero->id));
@@ -59,12 +62,210 @@ CPathfinder::CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstan
 	hlp = make_unique<CPathfinderHelper>(hero, options);
 
 	initializePatrol();
-	initializeGraph();
 	neighbourTiles.reserve(8);
 	neighbours.reserve(16);
 }
 
 void CPathfinder::calculatePaths()
+{
+	search(false);
+}
+
+void CPathfinder::calculatePathsWithUpdatedGraph()
+{
+	search(true);
+}
+
+void CPathfinder::search(bool graphUpdated)
+{
+	out.newEpoch();
+	initializeGraph(graphUpdated);
+
+	//logGlobal->infoStream() << boost::format("Calculating paths for hero %s (adress  %d) of player %d") % hero->name % hero % hero->tempOwner;
+
+	//initial tile - set cost on 0 and add to the queue
+	CGPathNode * initialNode = out.getNode(out.hpos, hero->boat ? ELayer::SAIL : ELayer::LAND);
+	initialNode->turns = 0;
+	initialNode->moveRemains = hero->movement;
+	if(isHeroPatrolLocked())
+		return;
+
+	pq.push(initialNode);
+	processQueue();
+}
+
+void CPathfinder::updatePaths(const std::vector<int3> & changedTiles)
+{
+	CGPathNode * initialNode = out.getNode(out.hpos, hero->boat ? ELayer::SAIL : ELayer::LAND);
+	if(patrolState != PATROL_NONE || initialNode->turns != 0 || initialNode->theNodeBefore != CGPathNode::NO_NODE
+		|| initialNode->moveRemains != hero->movement)
+	{
+		//hero moved or his movement points changed, previous results are of no use
+		calculatePaths();
+		return;
+	}
+
+	const ui32 initialIndex = out.getNodeIndex(initialNode);
+	std::unordered_set<ui32> invalid;
+	std::vector<ui32> invalidNodes;
+	auto invalidate = [&](ui32 index) -> bool
+	{
+		if(index == initialIndex || !invalid.insert(index).second)
+			return false;
+		invalidNodes.push_back(index);
+		return true;
+	};
+
+	if(out.graph)
+		updateGraph(*out.graph);
+
+	for(auto & pos : getAffectedTiles(changedTiles))
+	{
+		const ui32 first = out.getNodeIndex(pos, ELayer::LAND);
+		if(out.graph)
+			std::copy_n(out.graph->accessibility.begin() + first, ELayer::NUM_LAYERS, out.accessibility.begin() + first);
+		else
+			initializeTile(pos, out.accessibility);
+
+		for(ui32 i = first; i < first + ELayer::NUM_LAYERS; i++)
+		{
+			if(!invalidate(i) && i == initialIndex)
+				initialNode->accessible = out.accessibility[i];
+		}
+	}
+
+	//every node that was reached through a changed tile is invalid as well
+	//predecessor of a node is on neighbouring tile, except for teleports which are checked separately
+	auto isReachedFrom = [&](ui32 index, ui32 parent) -> bool
+	{
+		const CGPathNode & node = out.nodes[index];
+		return node.epoch == out.epoch && node.theNodeBefore == parent;
+	};
+	const std::vector<ui32> teleportTargets = getTeleportTargets();
+	size_t checked = 0;
+	bool teleportInvalidated = true;
+	while(teleportInvalidated)
+	{
+		for(; checked < invalidNodes.size(); checked++)
+		{
+			const ui32 parent = invalidNodes[checked];
+			const int3 coord = out.nodes[parent].coord;
+			for(int3 dir(-1, -1, 0); dir.x <= 1; dir.x++)
+			{
+				for(dir.y = -1; dir.y <= 1; dir.y++)
+				{
+					const int3 tile = coord + dir;
+					if(!gs->map->isInTheMap(tile))
+						continue;
+
+					const ui32 first = out.getNodeIndex(tile, ELayer::LAND);
+					for(ui32 i = first; i < first + ELayer::NUM_LAYERS; i++)
+					{
+						if(isReachedFrom(i, parent))
+							invalidate(i);
+					}
+				}
+			}
+		}
+
+		teleportInvalidated = false;
+		for(ui32 index : teleportTargets)
+		{
+			const ui32 parent = out.nodes[index].theNodeBefore;
+			if(parent != CGPathNode::NO_NODE && isReachedFrom(index, parent) && vstd::contains(invalid, parent))
+				teleportInvalidated |= invalidate(index);
+		}
+	}
+
+	std::unordered_set<ui32> seeds;
+	auto addSeed = [&](ui32 index)
+	{
+		if(vstd::contains(invalid, index) || !seeds.insert(index).second)
+			return;
+
+		CGPathNode * node = out.getNode(index);
+		if(node->reachable())
+			pq.push(node);
+	};
+
+	for(ui32 index : invalidNodes)
+	{
+		CGPathNode * node = out.getNode(index);
+		if(node->theNodeBefore != CGPathNode::NO_NODE)
+			addSeed(node->theNodeBefore);
+
+		node->reset();
+		node->accessible = out.accessibility[index];
+
+		//valid neighbours will try to reach this node again
+		neighbourTiles.clear();
+		CPathfinderHelper::getNeighbours(gs->map, gs->map->getTile(node->coord), node->coord, neighbourTiles, boost::logic::indeterminate, node->layer == ELayer::SAIL);
+		for(auto & tile : neighbourTiles)
+		{
+			for(ui32 i = out.getNodeIndex(tile, ELayer::LAND); i < out.getNodeIndex(tile, ELayer::LAND) + ELayer::NUM_LAYERS; i++)
+				addSeed(i);
+		}
+	}
+
+	//teleport exits are not neighbours of their entrances
+	for(auto & channel : gs->map->teleportChannels)
+	{
+		for(auto & id : channel.second->entrances)
+		{
+			auto obj = getObj(id, false);
+			if(!obj)
+				continue;
+
+			int3 pos = obj->visitablePos();
+			for(ui32 i = out.getNodeIndex(pos, ELayer::LAND); i < out.getNodeIndex(pos, ELayer::LAND) + ELayer::NUM_LAYERS; i++)
+				addSeed(i);
+		}
+	}
+
+	//hero tile itself might have changed and it's never invalidated
+	addSeed(initialIndex);
+
+	//nodes finalized by the previous run may be improved by routes through changed tiles
+	repairing = true;
+	processQueue();
+}
+
+std::vector<ui32> CPathfinder::getTeleportTargets() const
+{
+	std::vector<int3> tiles;
+	for(auto & channel : gs->map->teleportChannels)
+	{
+		for(auto & id : channel.second->exits)
+		{
+			auto obj = getObj(id, false);
+			if(!obj)
+				continue;
+
+			if(dynamic_cast<const CGWhirlpool *>(obj))
+			{
+				auto blockedPos = obj->getBlockedPos();
+				tiles.insert(tiles.end(), blockedPos.begin(), blockedPos.end());
+			}
+			tiles.push_back(obj->visitablePos());
+		}
+	}
+	if(options.useCastleGate)
+	{
+		for(auto town : getPlayer(hero->tempOwner)->towns)
+			tiles.push_back(town->visitablePos());
+	}
+
+	std::vector<ui32> ret;
+	for(auto & tile : tiles)
+	{
+		const ui32 first = out.getNodeIndex(tile, ELayer::LAND);
+		for(ui32 i = first; i < first + ELayer::NUM_LAYERS; i++)
+			ret.push_back(i);
+	}
+	return ret;
+}
+
+void CPathfinder::processQueue()
 {
 	auto passOneTurnLimitCheck = [&]() -> bool
 	{
@@ -96,16 +297,6 @@ void CPathfinder::calculatePaths()
 		return false;
 	};
 
-	//logGlobal->infoStream() << boost::format("Calculating paths for hero %s (adress  %d) of player %d") % hero->name % hero % hero->tempOwner;
-
-	//initial tile - set cost on 0 and add to the queue
-	CGPathNode * initialNode = out.getNode(out.hpos, hero->boat ? ELayer::SAIL : ELayer::LAND);
-	initialNode->turns = 0;
-	initialNode->moveRemains = hero->movement;
-	if(isHeroPatrolLocked())
-		return;
-
-	pq.push(initialNode);
 	while(!pq.empty())
 	{
 		cp = pq.top();
@@ -143,7 +334,7 @@ void CPathfinder::calculatePaths()
 					continue;
 
 				dp = out.getNode(neighbour, i);
-				if(dp->locked)
+				if(dp->locked && !repairing)
 					continue;
 
 				if(dp->accessible == CGPathNode::NOT_SET)
@@ -179,10 +370,10 @@ void CPathfinder::calculatePaths()
 				if(isBetterWay(remains, turnAtNextTile) &&
 					((cp->turns == turnAtNextTile && remains) || passOneTurnLimitCheck()))
 				{
-					assert(dp != cp->theNodeBefore); //two tiles can't point to each other
+					assert(out.getNodeIndex(dp) != cp->theNodeBefore); //two tiles can't point to each other
 					dp->moveRemains = remains;
 					dp->turns = turnAtNextTile;
-					dp->theNodeBefore = cp;
+					dp->theNodeBefore = out.getNodeIndex(cp);
 					dp->action = destAction;
 
 					if(isMovementAfterDestPossible())
@@ -196,7 +387,7 @@ void CPathfinder::calculatePaths()
 		for(auto & neighbour : neighbours)
 		{
 			dp = out.getNode(neighbour, cp->layer);
-			if(dp->locked)
+			if(dp->locked && !repairing)
 				continue;
 			/// TODO: We may consider use invisible exits on FoW border in future
 			/// Useful for AI when at least one tile around exit is visible and passable
@@ -212,7 +403,7 @@ void CPathfinder::calculatePaths()
 
 				dp->moveRemains = movement;
 				dp->turns = turn;
-				dp->theNodeBefore = cp;
+				dp->theNodeBefore = out.getNodeIndex(cp);
 				dp->action = getTeleportDestAction();
 				if(dp->action == CGPathNode::TELEPORT_NORMAL)
 					pq.push(dp);
@@ -672,45 +863,98 @@ void CPathfinder::initializePatrol()
 	patrolState = state;
 }
 
-void CPathfinder::initializeGraph()
+void CPathfinder::initializeGraph(bool graphUpdated)
 {
-	auto updateNode = [&](int3 pos, ELayer layer, const TerrainTile * tinfo)
+	//nodes themselves are reset lazily, here only accessibility of all layers is written
+	if(out.graph)
 	{
-		auto node = out.getNode(pos, layer);
-		auto accessibility = evaluateAccessibility(pos, tinfo, layer);
-		node->update(pos, layer, accessibility);
-	};
+		if(!graphUpdated)
+			updateGraph(*out.graph);
+		assert(out.graph->initialized && out.graph->changedTiles.empty());
+		out.accessibility = out.graph->accessibility;
+	}
+	else
+		evaluateGraph(out.accessibility);
+}
 
+void CPathfinder::updateGraph(CPathsGraph & graph)
+{
+	assert(graph.owner == hero->tempOwner);
+	if(!graph.initialized)
+	{
+		graph.accessibility.resize(out.accessibility.size());
+		evaluateGraph(graph.accessibility);
+		graph.initialized = true;
+	}
+	else
+	{
+		for(auto & pos : getAffectedTiles(graph.changedTiles))
+			initializeTile(pos, graph.accessibility);
+	}
+	graph.changedTiles.clear();
+}
+
+void CPathfinder::evaluateGraph(std::vector<CGPathNode::EAccessibility> & accessibility)
+{
 	int3 pos;
 	for(pos.x=0; pos.x < out.sizes.x; ++pos.x)
 	{
 		for(pos.y=0; pos.y < out.sizes.y; ++pos.y)
 		{
 			for(pos.z=0; pos.z < out.sizes.z; ++pos.z)
+				initializeTile(pos, accessibility);
+		}
+	}
+}
+
+void CPathfinder::initializeTile(const int3 & pos, std::vector<CGPathNode::EAccessibility> & accessibilityOut)
+{
+	CGPathNode::EAccessibility * accessibility = &accessibilityOut[out.getNodeIndex(pos, ELayer::LAND)];
+	auto updateNode = [&](ELayer layer, const TerrainTile * tinfo)
+	{
+		accessibility[layer] = evaluateAccessibility(pos, tinfo, layer);
+	};
+
+	const TerrainTile * tinfo = &gs->map->getTile(pos);
+	std::fill(accessibility, accessibility + ELayer::NUM_LAYERS, CGPathNode::NOT_SET);
+	switch(tinfo->terType)
+	{
+	case ETerrainType::ROCK:
+		break;
+
+	case ETerrainType::WATER:
+		updateNode(ELayer::SAIL, tinfo);
+		if(options.useFlying)
+			updateNode(ELayer::AIR, tinfo);
+		if(options.useWaterWalking)
+			updateNode(ELayer::WATER, tinfo);
+		break;
+
+	default:
+		updateNode(ELayer::LAND, tinfo);
+		if(options.useFlying)
+			updateNode(ELayer::AIR, tinfo);
+		break;
+	}
+}
+
+std::unordered_set<int3, ShashInt3> CPathfinder::getAffectedTiles(const std::vector<int3> & changedTiles) const
+{
+	//guards and visitable objects affect neighbouring tiles as well
+	std::unordered_set<int3, ShashInt3> ret;
+	for(auto & tile : changedTiles)
+	{
+		for(int dx = -1; dx <= 1; dx++)
+		{
+			for(int dy = -1; dy <= 1; dy++)
 			{
-				const TerrainTile * tinfo = &gs->map->getTile(pos);
-				switch(tinfo->terType)
-				{
-				case ETerrainType::ROCK:
-					break;
-
-				case ETerrainType::WATER:
-					updateNode(pos, ELayer::SAIL, tinfo);
-					if(options.useFlying)
-						updateNode(pos, ELayer::AIR, tinfo);
-					if(options.useWaterWalking)
-						updateNode(pos, ELayer::WATER, tinfo);
-					break;
-
-				default:
-					updateNode(pos, ELayer::LAND, tinfo);
-					if(options.useFlying)
-						updateNode(pos, ELayer::AIR, tinfo);
-					break;
-				}
+				int3 pos = tile + int3(dx, dy, 0);
+				if(isInTheMap(pos))
+					ret.insert(pos);
 			}
 		}
 	}
+	return ret;
 }
 
 CGPathNode::EAccessibility CPathfinder::evaluateAccessibility(const int3 & pos, const TerrainTile * tinfo, const ELayer layer) const
@@ -1121,7 +1365,7 @@ int CPathfinderHelper::getMovementCost(const CGHeroInstance * h, const int3 & ds
 }
 
 CGPathNode::CGPathNode()
-	: coord(int3(-1, -1, -1)), layer(ELayer::WRONG)
+	: coord(int3(-1, -1, -1)), layer(ELayer::WRONG), epoch(0)
 {
 	reset();
 }
@@ -1132,21 +1376,9 @@ void CGPathNode::reset()
 	accessible = NOT_SET;
 	moveRemains = 0;
 	turns = 255;
-	theNodeBefore = nullptr;
+	theNodeBefore = NO_NODE;
 	action = UNKNOWN;
-}
-
-void CGPathNode::update(const int3 & Coord, const ELayer Layer, const EAccessibility Accessible)
-{
-	if(layer == ELayer::WRONG)
-	{
-		coord = Coord;
-		layer = Layer;
-	}
-	else
-		reset();
-
-	accessible = Accessible;
+	queueIndex = 0;
 }
 
 bool CGPathNode::reachable() const
@@ -1179,7 +1411,10 @@ CPathsInfo::CPathsInfo(const int3 & Sizes)
 	: sizes(Sizes)
 {
 	hero = nullptr;
-	nodes.resize(boost::extents[sizes.x][sizes.y][sizes.z][ELayer::NUM_LAYERS]);
+	graph = nullptr;
+	epoch = 1;
+	accessibility.resize(sizes.x * sizes.y * sizes.z * ELayer::NUM_LAYERS, CGPathNode::NOT_SET);
+	nodes.resize(accessibility.size());
 }
 
 CPathsInfo::~CPathsInfo()
@@ -1202,13 +1437,13 @@ bool CPathsInfo::getPath(CGPath & out, const int3 & dst) const
 
 	out.nodes.clear();
 	const CGPathNode * curnode = getNode(dst);
-	if(!curnode->theNodeBefore)
+	if(curnode->theNodeBefore == CGPathNode::NO_NODE)
 		return false;
 
 	while(curnode)
 	{
 		const CGPathNode cpn = * curnode;
-		curnode = curnode->theNodeBefore;
+		curnode = cpn.theNodeBefore != CGPathNode::NO_NODE ? getNode(cpn.theNodeBefore) : nullptr;
 		out.nodes.push_back(cpn);
 	}
 	return true;
@@ -1227,14 +1462,170 @@ int CPathsInfo::getDistance(const int3 & tile) const
 
 const CGPathNode * CPathsInfo::getNode(const int3 & coord) const
 {
-	auto landNode = &nodes[coord.x][coord.y][coord.z][ELayer::LAND];
+	auto landNode = getNode(getNodeIndex(coord, ELayer::LAND));
 	if(landNode->reachable())
 		return landNode;
 	else
-		return &nodes[coord.x][coord.y][coord.z][ELayer::SAIL];
+		return getNode(getNodeIndex(coord, ELayer::SAIL));
 }
 
 CGPathNode * CPathsInfo::getNode(const int3 & coord, const ELayer layer)
 {
-	return &nodes[coord.x][coord.y][coord.z][layer];
+	return getNode(getNodeIndex(coord, layer));
+}
+
+CGPathNode * CPathsInfo::getNode(ui32 index) const
+{
+	CGPathNode * node = &nodes[index];
+	if(node->epoch != epoch)
+	{
+		node->reset();
+		node->epoch = epoch;
+		node->accessible = accessibility[index];
+		node->layer = static_cast<ELayer::EEPathfindingLayer>(index % ELayer::NUM_LAYERS);
+		index /= ELayer::NUM_LAYERS;
+		node->coord.z = index % sizes.z;
+		index /= sizes.z;
+		node->coord.y = index % sizes.y;
+		node->coord.x = index / sizes.y;
+	}
+	return node;
+}
+
+CPathsGraph::CPathsGraph(PlayerColor Owner)
+	: owner(Owner), initialized(false)
+{
+}
+
+void CPathsGraph::invalidate()
+{
+	initialized = false;
+	changedTiles.clear();
+}
+
+void CPathsGraph::invalidate(const std::vector<int3> & tiles)
+{
+	if(initialized)
+		changedTiles.insert(changedTiles.end(), tiles.begin(), tiles.end());
+}
+
+bool CPathNodeQueue::isBetter(const CGPathNode * lhs, const CGPathNode * rhs)
+{
+	if(lhs->turns != rhs->turns)
+		return lhs->turns < rhs->turns;
+
+	return lhs->moveRemains > rhs->moveRemains;
+}
+
+bool CPathNodeQueue::contains(const CGPathNode * node) const
+{
+	//index may be left over from another queue, so it's verified
+	return node->queueIndex < heap.size() && heap[node->queueIndex] == node;
+}
+
+void CPathNodeQueue::place(CGPathNode * node, size_t pos)
+{
+	heap[pos] = node;
+	node->queueIndex = pos;
+}
+
+void CPathNodeQueue::siftUp(size_t pos)
+{
+	CGPathNode * node = heap[pos];
+	while(pos > 0)
+	{
+		size_t parent = (pos - 1) / 4;
+		if(!isBetter(node, heap[parent]))
+			break;
+
+		place(heap[parent], pos);
+		pos = parent;
+	}
+	place(node, pos);
+}
+
+void CPathNodeQueue::siftDown(size_t pos)
+{
+	CGPathNode * node = heap[pos];
+	while(true)
+	{
+		size_t first = pos * 4 + 1;
+		if(first >= heap.size())
+			break;
+
+		size_t best = first;
+		for(size_t child = first + 1; child < std::min(first + 4, heap.size()); child++)
+		{
+			if(isBetter(heap[child], heap[best]))
+				best = child;
+		}
+		if(!isBetter(heap[best], node))
+			break;
+
+		place(heap[best], pos);
+		pos = best;
+	}
+	place(node, pos);
+}
+
+bool CPathNodeQueue::empty() const
+{
+	return heap.empty();
+}
+
+size_t CPathNodeQueue::size() const
+{
+	return heap.size();
+}
+
+CGPathNode * CPathNodeQueue::top() const
+{
+	return heap.front();
+}
+
+void CPathNodeQueue::pop()
+{
+	heap.front() = heap.back();
+	heap.pop_back();
+	if(!heap.empty())
+		siftDown(0);
+}
+
+void CPathNodeQueue::push(CGPathNode * node)
+{
+	if(contains(node))
+	{
+		//decrease-key, cost of queued node can only improve
+		siftUp(node->queueIndex);
+		return;
+	}
+
+	heap.push_back(node);
+	siftUp(heap.size() - 1);
+}
+
+void CPathNodeQueue::clear()
+{
+	heap.clear();
+}
+
+ui32 CPathsInfo::getNodeIndex(const int3 & coord, const ELayer layer) const
+{
+	return ((coord.x * sizes.y + coord.y) * sizes.z + coord.z) * ELayer::NUM_LAYERS + layer.num;
+}
+
+ui32 CPathsInfo::getNodeIndex(const CGPathNode * node) const
+{
+	return node - nodes.data();
+}
+
+void CPathsInfo::newEpoch()
+{
+	if(++epoch == 0)
+	{
+		//counter wrapped around, old stamps could be mistaken for current ones
+		for(auto & node : nodes)
+			node.epoch = 0;
+		epoch = 1;
+	}
 }
@@ -5,8 +5,6 @@
 #include "HeroBonus.h"
 #include "int3.h"
 
-#include <boost/heap/priority_queue.hpp>
-
 /*
  * CPathfinder.h, part of VCMI engine
  *
@@ -52,18 +50,21 @@ struct DLL_LINKAGE CGPathNode
 		BLOCKED //tile can't be entered nor visited
 	};
 
-	CGPathNode * theNodeBefore;
+	static const ui32 NO_NODE = 0xFFFFFFFF;
+
+	ui32 theNodeBefore; //index of previous node in CPathsInfo, NO_NODE if there is none
 	int3 coord; //coordinates
-	ui32 moveRemains; //remaining tiles after hero reaches the tile
-	ui8 turns; //how many turns we have to wait before reachng the tile - 0 means current turn
+	ui32 moveRemains : 24; //remaining tiles after hero reaches the tile
+	ui32 turns : 8; //how many turns we have to wait before reachng the tile - 0 means current turn
 	ELayer layer;
 	EAccessibility accessible;
 	ENodeAction action;
 	bool locked;
+	ui32 epoch; //pathfinding run this node was last reset for, see CPathsInfo::epoch
+	ui32 queueIndex; //position in CPathNodeQueue, only meaningful while node is queued
 
 	CGPathNode();
 	void reset();
-	void update(const int3 & Coord, const ELayer Layer, const EAccessibility Accessible);
 	bool reachable() const;
 };
 
@@ -76,6 +77,41 @@ struct DLL_LINKAGE CGPath
 	void convert(ui8 mode); //mode=0 -> from 'manifest' to 'object'
 };
 
+/// Indexed 4-ary heap of path nodes, node with least turns and then most move points left goes first.
+/// Every node is queued at most once, pushing already queued node after its cost improved only moves it up.
+class DLL_LINKAGE CPathNodeQueue
+{
+	std::vector<CGPathNode *> heap;
+
+	static bool isBetter(const CGPathNode * lhs, const CGPathNode * rhs);
+	bool contains(const CGPathNode * node) const;
+	void place(CGPathNode * node, size_t pos);
+	void siftUp(size_t pos);
+	void siftDown(size_t pos);
+
+public:
+	bool empty() const;
+	size_t size() const;
+	CGPathNode * top() const;
+	void pop();
+	void push(CGPathNode * node);
+	void clear();
+};
+
+/// Accessibility of all nodes as seen by one player. It doesn't depend on particular hero,
+/// so it's evaluated once and shared by pathfinders of all his heroes.
+struct DLL_LINKAGE CPathsGraph
+{
+	PlayerColor owner;
+	bool initialized;
+	std::vector<CGPathNode::EAccessibility> accessibility; //ordered like CPathsInfo::nodes
+	std::vector<int3> changedTiles; //objects or visibility of these tiles changed since graph was used
+
+	CPathsGraph(PlayerColor Owner);
+	void invalidate(); //whole graph will be evaluated again
+	void invalidate(const std::vector<int3> & tiles);
+};
+
 struct DLL_LINKAGE CPathsInfo
 {
 	typedef EPathfindingLayer ELayer;
@@ -85,16 +121,28 @@ struct DLL_LINKAGE CPathsInfo
 	const CGHeroInstance * hero;
 	int3 hpos;
 	int3 sizes;
-	boost::multi_array<CGPathNode, 4> nodes; //[w][h][level][layer]
+
+	/// Id of the last pathfinding run. Instead of resetting the whole graph on every run
+	/// nodes stamped with older epoch are reset when they are accessed for the first time.
+	ui32 epoch;
+	/// Accessibility of every node as evaluated by the last run, ordered like nodes.
+	/// Kept apart so graph initialization writes one byte per node.
+	std::vector<CGPathNode::EAccessibility> accessibility;
+	mutable std::vector<CGPathNode> nodes; //[w][h][level][layer], lazily reset when read
+	CPathsGraph * graph; //if set, accessibility is taken from it instead of being evaluated for every hero
 
 	CPathsInfo(const int3 & Sizes);
 	~CPathsInfo();
 	const CGPathNode * getPathInfo(const int3 & tile) const;
 	bool getPath(CGPath & out, const int3 & dst) const;
 	int getDistance(const int3 & tile) const;
-	const CGPathNode * getNode(const int3 & coord) const;
+	const CGPathNode * getNode(const int3 & coord) const; //requires pathMx
 
 	CGPathNode * getNode(const int3 & coord, const ELayer layer);
+	CGPathNode * getNode(ui32 index) const;
+	ui32 getNodeIndex(const int3 & coord, const ELayer layer) const;
+	ui32 getNodeIndex(const CGPathNode * node) const;
+	void newEpoch(); //invalidates all nodes, called at the start of every run
 };
 
 class CPathfinder : private CGameInfoCallback
@@ -104,6 +152,12 @@ public:
 
 	CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstance * _hero);
 	void calculatePaths(); //calculates possible paths for hero, uses current hero position and movement left; returns pointer to newly allocated CPath or nullptr if path does not exists
+	void calculatePathsWithUpdatedGraph(); //as above, but shared graph was already brought up to date by caller and is only read, so it's safe to run concurrently
+	/// Repairs paths previously calculated for the same hero after objects or visibility of given tiles changed.
+	/// Only nodes reached through changed tiles are recalculated, work is proportional to their count and the area they open or close.
+	/// Falls back to calculatePaths if hero moved since then.
+	void updatePaths(const std::vector<int3> & changedTiles);
+	void updateGraph(CPathsGraph & graph); //evaluates tiles of the graph that changed since its last use
 
 private:
 	typedef EPathfindingLayer ELayer;
@@ -171,19 +225,8 @@ private:
 	} patrolState;
 	std::unordered_set<int3, ShashInt3> patrolTiles;
 
-	struct NodeComparer
-	{
-		bool operator()(const CGPathNode * lhs, const CGPathNode * rhs) const
-		{
-			if(rhs->turns > lhs->turns)
-				return false;
-			else if(rhs->turns == lhs->turns && rhs->moveRemains < lhs->moveRemains)
-				return false;
-
-			return true;
-		}
-	};
-	boost::heap::priority_queue<CGPathNode *, boost::heap::compare<NodeComparer> > pq;
+	CPathNodeQueue pq;
+	bool repairing; //updating results of previous run, nodes it finalized can still be improved
 
 	std::vector<int3> neighbourTiles;
 	std::vector<int3> neighbours;
@@ -194,6 +237,8 @@ private:
 	const CGObjectInstance * ctObj, * dtObj;
 	CGPathNode::ENodeAction destAction;
 
+	void search(bool graphUpdated); //full run from hero position
+	void processQueue();
 	void addNeighbours();
 	void addTeleportExits();
 
@@ -215,7 +260,11 @@ private:
 	bool isDestinationGuardian() const;
 
 	void initializePatrol();
-	void initializeGraph();
+	void initializeGraph(bool graphUpdated);
+	void evaluateGraph(std::vector<CGPathNode::EAccessibility> & accessibility);
+	void initializeTile(const int3 & pos, std::vector<CGPathNode::EAccessibility> & accessibility);
+	std::unordered_set<int3, ShashInt3> getAffectedTiles(const std::vector<int3> & changedTiles) const;
+	std::vector<ui32> getTeleportTargets() const; //nodes which can be reached from non-neighbouring tiles
 
 	CGPathNode::EAccessibility evaluateAccessibility(const int3 & pos, const TerrainTile * tinfo, const ELayer layer) const;
 	bool isVisitableObj(const CGObjectInstance * obj, const ELayer layer) const;
@@ -70,7 +70,42 @@ public:
 
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
-		h & id & players & fogOfWarMap;
+		h & id & players;
+		if(version >= 764)
+		{
+			//columns of the map have only one or two tiles, so whole map goes as a single block
+			int3 sizes;
+			std::vector<ui8> visible;
+			if(h.saving)
+			{
+				sizes.x = fogOfWarMap.size();
+				sizes.y = sizes.x ? fogOfWarMap[0].size() : 0;
+				sizes.z = sizes.y ? fogOfWarMap[0][0].size() : 0;
+				visible.reserve(sizes.x * sizes.y * sizes.z);
+				for(auto & column : fogOfWarMap)
+					for(auto & tile : column)
+						visible.insert(visible.end(), tile.begin(), tile.end());
+			}
+			h & sizes & visible;
+			if(!h.saving)
+			{
+				if(visible.size() != static_cast<size_t>(sizes.x * sizes.y * sizes.z))
+					throw std::runtime_error("Invalid fog of war data");
+				fogOfWarMap.resize(sizes.x);
+				auto tile = visible.begin();
+				for(auto & column : fogOfWarMap)
+				{
+					column.resize(sizes.y);
+					for(auto & levels : column)
+					{
+						levels.assign(tile, tile + sizes.z);
+						tile += sizes.z;
+					}
+				}
+			}
+		}
+		else
+			h & fogOfWarMap;
 		h & static_cast<CBonusSystemNode&>(*this);
 	}
 
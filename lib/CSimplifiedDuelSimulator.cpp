@@ -0,0 +1,513 @@
+/*
+ * CSimplifiedDuelSimulator.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "CSimplifiedDuelSimulator.h"
+
+#include <chrono>
+
+#include "BattleState.h"
+#include "CGameState.h"
+#include "CObstacleInstance.h"
+#include "CThreadPool.h"
+#include "NetPacks.h"
+#include "mapObjects/CGHeroInstance.h"
+#include "mapObjects/MiscObjects.h"
+
+struct CSimplifiedDuelSimulator::Duel
+{
+	std::string name;
+	DuelParameters params;
+	size_t battles;
+	si32 seed;
+
+	std::vector<BattleOutcome> outcomes;
+	double time; //milliseconds of wall time for all battles
+	CBonusSystemNode::CachingStats cachingStats; //of all battles of the duel
+};
+
+namespace
+{
+	//bonus system tree and type registration are shared by all battles, battles are set up and destroyed one at a time
+	//and packs that attach or detach nodes of the shared tree are applied under this lock too
+	boost::mutex setupMx;
+
+	CArmedInstance * createArmy(const DuelParameters::SideSettings & side, PlayerColor owner, CRandomGenerator & rand)
+	{
+		CArmedInstance * army;
+		CGHeroInstance * hero = nullptr;
+		if(side.heroId >= 0)
+		{
+			army = hero = new CGHeroInstance();
+			hero->subID = side.heroId;
+			for(int i = 0; i < side.heroPrimSkills.size(); i++)
+				hero->pushPrimSkill(static_cast<PrimarySkill::PrimarySkill>(i), side.heroPrimSkills[i]);
+			for(auto & secSkill : side.heroSecSkills)
+				hero->setSecSkillLevel(SecondarySkill(secSkill.first), secSkill.second, 1);
+		}
+		else
+		{
+			army = new CGCreature();
+		}
+
+		army->setOwner(owner);
+		for(int i = 0; i < ARRAY_COUNT(side.stacks); i++)
+		{
+			if(side.stacks[i].count)
+				army->setCreature(SlotID(i), side.stacks[i].type, side.stacks[i].count);
+		}
+
+		//army is set before, so hero doesn't get default one
+		if(hero)
+			hero->initHero(rand, HeroTypeID(hero->subID));
+		return army;
+	}
+
+	/// Obstacles are changed by battles (like turnsRemaining of spell obstacles), so every battle gets its own copy
+	std::shared_ptr<CObstacleInstance> copyObstacle(const CObstacleInstance & obstacle)
+	{
+		if(auto spellObstacle = dynamic_cast<const SpellCreatedObstacle *>(&obstacle))
+			return std::make_shared<SpellCreatedObstacle>(*spellObstacle);
+		if(auto moat = dynamic_cast<const MoatObstacle *>(&obstacle))
+			return std::make_shared<MoatObstacle>(*moat);
+		return std::make_shared<CObstacleInstance>(obstacle);
+	}
+
+	/// Plays one battle with simplified melee and ranged rules by applying packs directly on the game state, like server would send them
+	class SimplifiedBattle
+	{
+		CGameState * gs;
+		BattleInfo * battle;
+		CRandomGenerator & rand;
+
+		template<typename T>
+		void apply(T & pack)
+		{
+			pack.applyGs(gs);
+		}
+
+		void apply(BattleStacksRemoved & pack)
+		{
+			//removed stacks are detached from all parents, including creature types shared with other battles
+			boost::unique_lock<boost::mutex> lock(setupMx);
+			pack.applyGs(gs);
+		}
+
+		si64 targetValue(const CStack * attacker, const CStack * defender) const
+		{
+			auto dmg = battle->battleEstimateDamage(rand, attacker, defender);
+			si64 hp = std::min<si64>((dmg.first + dmg.second) / 2, defender->totalHealth());
+			return hp * defender->getCreature()->AIValue / std::max<si64>(defender->MaxHealth(), 1);
+		}
+
+		void addHit(BattleAttack & bat, const CStack * attacker, const CStack * defender, int distance, bool secondary)
+		{
+			BattleStackAttacked bsa;
+			if(secondary)
+				bsa.flags |= BattleStackAttacked::SECONDARY;
+			bsa.attackerID = attacker->ID;
+			bsa.stackAttacked = defender->ID;
+			bsa.damageAmount = battle->calculateDmg(attacker, defender, bat.shot(), distance, bat.lucky(), bat.unlucky(), bat.deathBlow(), bat.ballistaDoubleDmg(), rand);
+			defender->prepareAttacked(bsa, rand);
+			bat.bsa.push_back(bsa);
+		}
+
+		void attack(const CStack * attacker, const CStack * defender, bool shot, bool counter, int distance)
+		{
+			BattleAttack bat;
+			bat.stackAttacking = attacker->ID;
+			if(shot)
+				bat.flags |= BattleAttack::SHOT;
+			if(counter)
+				bat.flags |= BattleAttack::COUNTER;
+
+			const int luck = attacker->LuckVal();
+			if(luck > 0 && rand.nextInt(23) < luck)
+				bat.flags |= BattleAttack::LUCKY;
+			if(rand.nextInt(99) < attacker->valOfBonuses(Bonus::DOUBLE_DAMAGE_CHANCE))
+				bat.flags |= BattleAttack::DEATH_BLOW;
+
+			addHit(bat, attacker, defender, distance, false);
+			if(!shot)
+			{
+				for(const CStack * other : battle->getAttackedCreatures(attacker, defender->position))
+					if(other != defender)
+						addHit(bat, attacker, other, distance, true);
+			}
+			apply(bat);
+		}
+
+		int additionalAttacks(const CStack * stack, Bonus::LimitEffect range) const
+		{
+			return stack->getBonuses(Selector::type(Bonus::ADDITIONAL_ATTACK),
+				Selector::effectRange(Bonus::NO_LIMIT).Or(Selector::effectRange(range)))->totalValue();
+		}
+
+		void shoot(const CStack * stack, const CStack * target)
+		{
+			StartAction start(BattleAction::makeShotAttack(stack, target));
+			apply(start);
+
+			attack(stack, target, true, false, 0);
+			if(target->hasBonusOfType(Bonus::RANGED_RETALIATION) && !stack->hasBonusOfType(Bonus::BLOCKS_RANGED_RETALIATION)
+				&& target->ableToRetaliate() && stack->alive())
+			{
+				attack(target, stack, true, true, 0);
+			}
+
+			for(int i = additionalAttacks(stack, Bonus::ONLY_DISTANCE_FIGHT); i > 0 && stack->alive() && target->alive() && stack->shots; i--)
+				attack(stack, target, true, false, 0);
+		}
+
+		int move(const CStack * stack, BattleHex dest, const ReachabilityInfo & reachability)
+		{
+			if(dest == stack->position)
+				return 0;
+
+			BattleStackMoved bsm;
+			bsm.stack = stack->ID;
+			bsm.tilesToMove.push_back(dest);
+			bsm.distance = reachability.distances[dest];
+			apply(bsm);
+			return bsm.distance;
+		}
+
+		void meleeAttack(const CStack * stack, const CStack * target, BattleHex from, const ReachabilityInfo & reachability)
+		{
+			StartAction start(BattleAction::makeMeleeAttack(stack, target, from));
+			apply(start);
+
+			const int distance = move(stack, from, reachability);
+			const int totalAttacks = 1 + additionalAttacks(stack, Bonus::ONLY_MELEE_FIGHT);
+			for(int i = 0; i < totalAttacks; i++)
+			{
+				if(stack->alive() && target->alive())
+					attack(stack, target, false, false, i ? 0 : distance);
+
+				if(i == 0 && !stack->hasBonusOfType(Bonus::BLOCKS_RETALIATION) && target->ableToRetaliate() && stack->alive())
+					attack(target, stack, false, true, 0);
+			}
+		}
+
+		bool approach(const CStack * stack, const TStacks & enemies, const ReachabilityInfo & reachability, const std::vector<BattleHex> & avHexes)
+		{
+			//closest tile next to any enemy
+			BattleHex destination;
+			int bestDistance = ReachabilityInfo::INFINITE_DIST;
+			for(const CStack * enemy : enemies)
+				for(BattleHex enemyHex : enemy->getHexes())
+					for(BattleHex hex : enemyHex.neighbouringTilesView())
+						if(reachability.distances[hex] < bestDistance)
+						{
+							bestDistance = reachability.distances[hex];
+							destination = hex;
+						}
+
+			if(!destination.isValid() || avHexes.empty())
+				return false;
+
+			BattleHex dest = destination;
+			if(stack->hasBonusOfType(Bonus::FLYING))
+			{
+				//flying stack doesn't go hex by hex, take the available hex closest to the target
+				dest = *boost::min_element(avHexes, [&](BattleHex a, BattleHex b)
+				{
+					return BattleHex::getDistance(a, destination) < BattleHex::getDistance(b, destination);
+				});
+			}
+			else
+			{
+				while(dest.isValid() && !vstd::contains(avHexes, dest))
+					dest = reachability.predecessors[dest];
+			}
+
+			if(!dest.isValid() || dest == stack->position)
+				return false;
+
+			StartAction start(BattleAction::makeMove(stack, dest));
+			apply(start);
+			move(stack, dest, reachability);
+			return true;
+		}
+
+		void makeTurn(const CStack * stack)
+		{
+			BattleSetActiveStack sas;
+			sas.stack = stack->ID;
+			apply(sas);
+
+			const TStacks enemies = battle->battleGetStacksIf([stack](const CStack * s)
+			{
+				return s->attackerOwned != stack->attackerOwned && s->isValidTarget();
+			});
+
+			const CStack * target = nullptr;
+			si64 bestValue = -1;
+			for(const CStack * enemy : enemies)
+			{
+				if(!battle->battleCanShoot(stack, enemy->position))
+					continue;
+
+				const si64 value = targetValue(stack, enemy);
+				if(value > bestValue)
+				{
+					bestValue = value;
+					target = enemy;
+				}
+			}
+			if(target)
+			{
+				shoot(stack, target);
+				return;
+			}
+
+			const auto reachability = battle->getReachability(stack);
+			const auto avHexes = battle->battleGetAvailableHexes(stack, false);
+			BattleHex from;
+			for(const CStack * enemy : enemies)
+			{
+				si64 value = -1;
+				for(BattleHex hex : avHexes)
+				{
+					if(!CStack::isMeleeAttackPossible(stack, enemy, hex))
+						continue;
+
+					if(value < 0)
+						value = targetValue(stack, enemy);
+					//prefer targets worth more, then shorter walk
+					if(value > bestValue || (value == bestValue && enemy == target && reachability.distances[hex] < reachability.distances[from]))
+					{
+						bestValue = value;
+						target = enemy;
+						from = hex;
+					}
+				}
+			}
+			if(target)
+			{
+				meleeAttack(stack, target, from, reachability);
+				return;
+			}
+
+			if(!approach(stack, enemies, reachability, avHexes))
+			{
+				StartAction start(BattleAction::makeDefend(stack));
+				apply(start);
+			}
+		}
+
+		void removeGhosts()
+		{
+			BattleStacksRemoved bsr;
+			for(const CStack * stack : battle->stacks)
+				if(vstd::contains(stack->state, EBattleStackState::GHOST_PENDING))
+					bsr.stackIDs.insert(stack->ID);
+
+			if(!bsr.stackIDs.empty())
+				apply(bsr);
+		}
+
+	public:
+		SimplifiedBattle(CGameState * GS, BattleInfo * Battle, CRandomGenerator & Rand)
+			: gs(GS), battle(Battle), rand(Rand)
+		{
+		}
+
+		/// Returns number of played rounds
+		si32 play(si32 maxRounds)
+		{
+			si32 rounds = 0;
+			while(!battle->battleIsFinished() && rounds < maxRounds)
+			{
+				BattleNextRound bnr;
+				bnr.round = battle->round + 1;
+				apply(bnr);
+				rounds++;
+
+				const CStack * next;
+				while(!battle->battleIsFinished() && (next = battle->getNextStack()) && next->willMove())
+				{
+					removeGhosts();
+					makeTurn(next);
+				}
+			}
+			return rounds;
+		}
+	};
+}
+
+CSimplifiedDuelSimulator::BattleOutcome::BattleOutcome()
+	: winner(2), rounds(0), time(0)
+{
+	casualties.fill(0);
+}
+
+CSimplifiedDuelSimulator::CSimplifiedDuelSimulator(const JsonNode & config)
+{
+	const size_t battles = config["battles"].isNull() ? 100 : config["battles"].Float();
+	const si32 seed = config["seed"].Float();
+	maxRounds = config["maxRounds"].isNull() ? 100 : config["maxRounds"].Float();
+	parallel = config["parallel"].isNull() || config["parallel"].Bool();
+
+	for(const JsonNode & duelConfig : config["duels"].Vector())
+	{
+		auto duel = make_unique<Duel>();
+		duel->name = duelConfig["name"].isNull() ? boost::lexical_cast<std::string>(duels.size()) : duelConfig["name"].String();
+		duel->params = DuelParameters::fromJSON(duelConfig);
+		duel->battles = duelConfig["battles"].isNull() ? battles : duelConfig["battles"].Float();
+		duel->seed = duelConfig["seed"].isNull() ? seed : duelConfig["seed"].Float();
+		duel->time = 0;
+		duel->cachingStats = CBonusSystemNode::CachingStats();
+		duels.push_back(std::move(duel));
+	}
+}
+
+CSimplifiedDuelSimulator::~CSimplifiedDuelSimulator() = default;
+
+void CSimplifiedDuelSimulator::run()
+{
+	for(auto & duel : duels)
+		runDuel(*duel);
+}
+
+void CSimplifiedDuelSimulator::runDuel(Duel & duel)
+{
+	logGlobal->info("Simulating %d battles of duel %s", duel.battles, duel.name);
+	duel.params.applyCustomCreatures();
+	duel.outcomes.assign(duel.battles, BattleOutcome());
+
+	CBonusSystemNode::resetCachingStats();
+	auto start = std::chrono::steady_clock::now();
+	//every task plays its share of battles on its own game state
+	const size_t tasks = parallel ? std::min(duel.battles, CThreadPool::get().size() * 4) : 1;
+	CThreadPool::get().parallelFor(0, tasks, [&](size_t task)
+	{
+		std::unique_ptr<CGameState> gs;
+		{
+			boost::unique_lock<boost::mutex> lock(setupMx);
+			gs = make_unique<CGameState>();
+		}
+
+		for(size_t i = task; i < duel.battles; i += tasks)
+			duel.outcomes[i] = playBattle(gs.get(), duel, i);
+
+		boost::unique_lock<boost::mutex> lock(setupMx);
+		gs.reset();
+	});
+	duel.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	duel.cachingStats = CBonusSystemNode::getCachingStats();
+}
+
+CSimplifiedDuelSimulator::BattleOutcome CSimplifiedDuelSimulator::playBattle(CGameState * gs, const Duel & duel, size_t index) const
+{
+	CRandomGenerator rand;
+	rand.setSeed(duel.seed + index);
+
+	const CArmedInstance * armies[2] = {nullptr};
+	const CGHeroInstance * heroes[2] = {nullptr};
+	{
+		boost::unique_lock<boost::mutex> lock(setupMx);
+		for(int i = 0; i < 2; i++)
+		{
+			armies[i] = createArmy(duel.params.sides[i], PlayerColor(i), rand);
+			heroes[i] = dynamic_cast<const CGHeroInstance *>(armies[i]);
+		}
+
+		gs->curB = BattleInfo::setupBattle(int3(-1,-1,-1), duel.params.terType, duel.params.bfieldType, armies, heroes, false, nullptr);
+		for(auto & obstacle : duel.params.obstacles)
+			gs->curB->obstacles.push_back(copyObstacle(*obstacle));
+		gs->curB->tacticDistance = 0; //nobody to play tactics phase
+		gs->curB->localInit();
+	}
+
+	BattleOutcome ret;
+	auto start = std::chrono::steady_clock::now();
+	SimplifiedBattle battle(gs, gs->curB, rand);
+	ret.rounds = battle.play(maxRounds);
+	ret.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if(auto result = gs->curB->battleIsFinished())
+		ret.winner = *result;
+
+	std::map<ui32, si32> casualties[2];
+	gs->curB->calculateCasualties(casualties);
+	for(int i = 0; i < 2; i++)
+		for(auto & elem : casualties[i])
+			ret.casualties[i] += static_cast<si64>(VLC->creh->creatures[elem.first]->AIValue) * elem.second;
+
+	boost::unique_lock<boost::mutex> lock(setupMx);
+	for(CStack * stack : gs->curB->stacks)
+		delete stack;
+	for(int i = 0; i < 2; i++)
+		gs->curB->battleGetArmyObject(i)->battle = nullptr;
+	gs->curB.dellNull();
+	for(auto army : armies)
+		delete army;
+	return ret;
+}
+
+JsonNode CSimplifiedDuelSimulator::getResults() const
+{
+	JsonNode ret;
+	for(auto & duel : duels)
+	{
+		JsonNode node;
+		node["name"].String() = duel->name;
+		node["battles"].Float() = duel->battles;
+
+		si64 wins[3] = {0};
+		double rounds = 0, casualties[2] = {0}, maxTime = 0;
+		JsonNode times(JsonNode::DATA_VECTOR);
+		for(auto & outcome : duel->outcomes)
+		{
+			wins[outcome.winner]++;
+			rounds += outcome.rounds;
+			for(int i = 0; i < 2; i++)
+				casualties[i] += outcome.casualties[i];
+			vstd::amax(maxTime, outcome.time);
+
+			JsonNode time;
+			time.Float() = outcome.time;
+			times.Vector().push_back(time);
+		}
+
+		const double count = std::max<size_t>(duel->outcomes.size(), 1);
+		for(int i = 0; i < 2; i++)
+		{
+			JsonNode side;
+			side["wins"].Float() = wins[i];
+			side["winRate"].Float() = wins[i] / count;
+			side["averageCasualties"].Float() = casualties[i] / count;
+			node["sides"].Vector().push_back(side);
+		}
+		node["draws"].Float() = wins[2];
+		node["averageRounds"].Float() = rounds / count;
+
+		double battlesTime = 0;
+		for(auto & outcome : duel->outcomes)
+			battlesTime += outcome.time;
+		node["time"]["total"].Float() = duel->time;
+		node["time"]["averageBattle"].Float() = battlesTime / count;
+		node["time"]["maxBattle"].Float() = maxTime;
+		node["time"]["battles"] = times;
+
+		//tree misses per battle grow with concurrent battles, as treeHasChanged() in any battle invalidates all of them
+		const auto & stats = duel->cachingStats;
+		node["bonusCache"]["treeHits"].Float() = stats.treeHits;
+		node["bonusCache"]["treeMisses"].Float() = stats.treeMisses;
+		node["bonusCache"]["treeMissesPerBattle"].Float() = stats.treeMisses / count;
+		node["bonusCache"]["treeChanges"].Float() = stats.treeChanges;
+		node["bonusCache"]["requestHits"].Float() = stats.requestHits;
+		node["bonusCache"]["requestMisses"].Float() = stats.requestMisses;
+
+		ret["duels"].Vector().push_back(node);
+	}
+	return ret;
+}
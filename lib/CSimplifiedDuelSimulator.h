@@ -0,0 +1,56 @@
+/*
+ * CSimplifiedDuelSimulator.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#pragma once
+
+#include "JsonNode.h"
+
+class CGameState;
+
+/// Simplified melee/ranged simulator: plays many seeded duels in-process, without server, clients, network and AI,
+/// and gathers statistics about them. It is not the game rules engine, results only approximate real battles:
+/// stacks act in queue order, shoot or walk and attack the target worth most AI value, otherwise approach the nearest enemy.
+/// Both sides use that policy; spells, morale, waiting, obstacles effects and abilities other than retaliation
+/// and additional attacks are not simulated.
+/// Every battle runs on its own BattleInfo and battles of one duel are spread over CThreadPool workers. Bonus caches
+/// are still invalidated globally by CBonusSystemNode::treeHasChanged(), so results report bonus cache statistics,
+/// compare them with a "parallel" : false run to see how much concurrent battles slow each other down.
+class DLL_LINKAGE CSimplifiedDuelSimulator : boost::noncopyable
+{
+public:
+	struct BattleOutcome
+	{
+		ui8 winner; //0 - attacker, 1 - defender, 2 - draw (no winner after maxRounds)
+		si32 rounds;
+		std::array<si64, 2> casualties; //AI value of creatures lost by each side
+		double time; //milliseconds spent playing the battle, without setting it up
+
+		BattleOutcome();
+	};
+
+	/// config format:
+	/// { "battles" : 1000, "seed" : 0, "maxRounds" : 100, "parallel" : true, "duels" : [ duel, ... ] }
+	/// every duel has the format of DuelParameters JSON, with optional "name", "battles" and "seed" overriding the defaults
+	explicit CSimplifiedDuelSimulator(const JsonNode & config);
+	~CSimplifiedDuelSimulator();
+
+	void run(); //plays all battles of all duels, duels one after another
+	JsonNode getResults() const; //win rates, casualties, timings and bonus cache statistics of every duel
+
+private:
+	struct Duel;
+
+	std::vector<std::unique_ptr<Duel>> duels;
+	si32 maxRounds;
+	bool parallel; //false plays battles one after another, to measure how concurrent battles affect each other
+
+	void runDuel(Duel & duel);
+	BattleOutcome playBattle(CGameState * gs, const Duel & duel, size_t index) const;
+};
@@ -16,39 +16,6 @@
  *
  */
 
-CThreadHelper::CThreadHelper(std::vector<std::function<void()> > *Tasks, int Threads)
-{
-	currentTask = 0; amount = Tasks->size();
-	tasks = Tasks;
-	threads = Threads;
-}
-void CThreadHelper::run()
-{
-	boost::thread_group grupa;
-	std::vector<boost::thread *> thr;
-	for(int i=0;i<threads;i++)
-		thr.push_back(grupa.create_thread(std::bind(&CThreadHelper::processTasks,this)));
-	grupa.join_all();
-
-	for(auto thread : thr)
-		delete thread;
-}
-void CThreadHelper::processTasks()
-{
-	while(true)
-	{
-		int pom;
-		{
-			boost::unique_lock<boost::mutex> lock(rtinm);
-			if((pom = currentTask) >= amount)
-				break;
-			else
-				++currentTask;
-		}
-		(*tasks)[pom]();
-	}
-}
-
 // set name for this thread.
 // NOTE: on *nix string will be trimmed to 16 symbols
 void setThreadName(const std::string &name)
@@ -0,0 +1,193 @@
+/*
+ * CThreadPool.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "CThreadPool.h"
+
+#include "CThreadHelper.h"
+
+bool CThreadPool::TaskGroup::State::runTask()
+{
+	Task task;
+	{
+		boost::unique_lock<boost::mutex> lock(mx);
+		if(tasks.empty())
+			return false;
+		task = std::move(tasks.front());
+		tasks.pop_front();
+	}
+
+	try
+	{
+		task();
+	}
+	catch(...)
+	{
+		boost::unique_lock<boost::mutex> lock(mx);
+		if(!error)
+			error = std::current_exception();
+	}
+
+	boost::unique_lock<boost::mutex> lock(mx);
+	if(--pending == 0)
+		cond.notify_all();
+	return true;
+}
+
+CThreadPool::TaskGroup::TaskGroup(CThreadPool & Pool)
+	: pool(Pool), state(std::make_shared<State>())
+{
+}
+
+CThreadPool::TaskGroup::~TaskGroup()
+{
+	try
+	{
+		wait();
+	}
+	catch(...)
+	{
+		logGlobal->error("Task group was destroyed without handling error of its task");
+	}
+}
+
+void CThreadPool::TaskGroup::run(Task task)
+{
+	{
+		boost::unique_lock<boost::mutex> lock(state->mx);
+		state->tasks.push_back(std::move(task));
+		state->pending++;
+	}
+
+	//pool runs whichever task of the group is first, if any is left
+	auto groupState = state;
+	pool.post([groupState](){ groupState->runTask(); });
+}
+
+void CThreadPool::TaskGroup::wait()
+{
+	while(state->runTask())
+		;
+
+	//remaining tasks are already running on other threads
+	boost::unique_lock<boost::mutex> lock(state->mx);
+	state->cond.wait(lock, [this](){ return state->pending == 0; });
+	if(state->error)
+	{
+		auto toThrow = state->error;
+		state->error = nullptr;
+		std::rethrow_exception(toThrow);
+	}
+}
+
+CThreadPool::CThreadPool(size_t threadsCount)
+	: queued(0), nextWorker(0), terminating(false)
+{
+	threadsCount = std::max<size_t>(threadsCount, 1);
+	for(size_t i = 0; i < threadsCount; i++)
+		workers.push_back(make_unique<Worker>());
+
+	for(size_t i = 0; i < threadsCount; i++)
+		threads.create_thread(std::bind(&CThreadPool::workerLoop, this, i));
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		boost::unique_lock<boost::mutex> lock(wakeMx);
+		terminating = true;
+	}
+	wakeCond.notify_all();
+	threads.join_all();
+}
+
+CThreadPool & CThreadPool::get()
+{
+	static CThreadPool pool(boost::thread::hardware_concurrency());
+	return pool;
+}
+
+size_t CThreadPool::size() const
+{
+	return workers.size();
+}
+
+void CThreadPool::post(Task task)
+{
+	//tasks spawned by a worker go to its own queue, others are spread evenly
+	int index = currentWorker();
+	Worker & worker = *workers[index >= 0 ? index : nextWorker++ % workers.size()];
+	{
+		boost::unique_lock<boost::mutex> lock(worker.mx);
+		worker.tasks.push_back(std::move(task));
+	}
+
+	boost::unique_lock<boost::mutex> lock(wakeMx);
+	queued++;
+	wakeCond.notify_one();
+}
+
+int CThreadPool::currentWorker() const
+{
+	return workerIndex.get() ? *workerIndex : -1;
+}
+
+bool CThreadPool::runTask()
+{
+	if(queued == 0)
+		return false;
+
+	Task task;
+	int self = currentWorker();
+	if(self >= 0)
+	{
+		Worker & worker = *workers[self];
+		boost::unique_lock<boost::mutex> lock(worker.mx);
+		if(!worker.tasks.empty())
+		{
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+		}
+	}
+
+	for(size_t i = 1; !task && i <= workers.size(); i++)
+	{
+		Worker & victim = *workers[(std::max(self, 0) + i) % workers.size()];
+		boost::unique_lock<boost::mutex> lock(victim.mx);
+		if(!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+	}
+
+	if(!task)
+		return false;
+
+	queued--;
+	task();
+	return true;
+}
+
+void CThreadPool::workerLoop(size_t index)
+{
+	setThreadName("CThreadPool::worker " + boost::lexical_cast<std::string>(index));
+	workerIndex.reset(new size_t(index));
+	while(true)
+	{
+		if(runTask())
+			continue;
+
+		boost::unique_lock<boost::mutex> lock(wakeMx);
+		if(terminating && queued == 0)
+			return;
+		wakeCond.wait(lock, [this](){ return terminating || queued > 0; });
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ * CThreadPool.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <future>
+
+/// Persistent pool of worker threads shared by server, client and AI.
+/// Every worker has its own queue: it takes newest tasks from its own queue and
+/// steals oldest tasks from queues of other workers when it runs out of work.
+/// Tasks are run on pool threads, so thread-specific state (like AI callback pointers) has to be set up by the task itself.
+class DLL_LINKAGE CThreadPool : boost::noncopyable
+{
+public:
+	typedef std::function<void()> Task;
+
+	/// Set of tasks that can be waited for together.
+	/// Thread waiting for the group executes not yet started tasks of this group meanwhile (but no others),
+	/// so groups may be nested and used from within tasks.
+	class DLL_LINKAGE TaskGroup : boost::noncopyable
+	{
+		/// Shared with pool, which may pick up a task after the waiting thread already executed it and the group is gone
+		struct State
+		{
+			boost::mutex mx;
+			boost::condition_variable cond; //notified when last task finishes
+			std::deque<Task> tasks; //not started yet
+			int pending; //queued or running
+			std::exception_ptr error;
+
+			State() : pending(0) {}
+			bool runTask(); //executes one not started task, returns false if there was none
+		};
+
+		CThreadPool & pool;
+		std::shared_ptr<State> state;
+
+	public:
+		explicit TaskGroup(CThreadPool & Pool = CThreadPool::get());
+		~TaskGroup(); //waits for remaining tasks, errors are dropped
+
+		void run(Task task);
+		void wait(); //rethrows first exception thrown by any task of the group
+	};
+
+	explicit CThreadPool(size_t threadsCount);
+	~CThreadPool(); //finishes queued tasks
+
+	static CThreadPool & get(); //pool shared by whole process, one worker per core
+
+	size_t size() const;
+
+	void post(Task task);
+
+	/// Runs func on the pool. Unlike waiting for a TaskGroup, waiting for the future does not help executing other tasks.
+	template<typename Func>
+	std::future<typename std::result_of<Func()>::type> async(Func func)
+	{
+		typedef typename std::result_of<Func()>::type TResult;
+		auto task = std::make_shared<std::packaged_task<TResult()>>(func);
+		auto ret = task->get_future();
+		post([task](){ (*task)(); });
+		return ret;
+	}
+
+	/// Calls func(i) for every i in [begin, end), in chunks of at least grain indices.
+	template<typename Func>
+	void parallelFor(size_t begin, size_t end, Func func, size_t grain = 1)
+	{
+		if(begin >= end)
+			return;
+
+		//few chunks per worker, so idle workers have something to steal
+		size_t chunk = std::max(grain, (end - begin) / (size() * 4) + 1);
+		if(chunk >= end - begin)
+		{
+			for(size_t i = begin; i < end; i++)
+				func(i);
+			return;
+		}
+
+		TaskGroup group(*this);
+		for(size_t first = begin; first < end; first += chunk)
+		{
+			size_t last = std::min(end, first + chunk);
+			group.run([&func, first, last]()
+			{
+				for(size_t i = first; i < last; i++)
+					func(i);
+			});
+		}
+		group.wait();
+	}
+
+private:
+	struct Worker
+	{
+		boost::mutex mx;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	boost::thread_group threads;
+	boost::thread_specific_ptr<size_t> workerIndex; //set only in worker threads
+
+	boost::mutex wakeMx;
+	boost::condition_variable wakeCond;
+	std::atomic<size_t> queued;
+	std::atomic<size_t> nextWorker;
+	bool terminating;
+
+	int currentWorker() const; //index of worker running this thread, -1 if it isn't a pool thread
+	bool runTask(); //executes one queued task, returns false if there was none
+	void workerLoop(size_t index);
+};
@@ -82,10 +82,30 @@ const std::map<std::string, TPropagatorPtr> bonusPropagatorMap =
 
 #define BONUS_LOG_LINE(x) logBonus->traceStream() << x
 
-int CBonusSystemNode::treeChanged = 1;
+std::atomic<int> CBonusSystemNode::treeChanged(1);
+std::atomic<si64> CBonusSystemNode::lastNodeChange(0);
 const bool CBonusSystemNode::cachingEnabled = true;
 
-BonusList::BonusList(bool BelongsToTree /* =false */) : belongsToTree(BelongsToTree)
+static CBonusSystemNode::CachingStats cachingStats = {0, 0, 0, 0, 0};
+static int treeChangedAtReset = 1;
+static boost::mutex cachingMutex;
+
+namespace
+{
+	// BonusCacheKey layout: [63] subtype field holds source id, [62..56] value type, [55..48] source, [47..32] type, [31..0] subtype / source id
+	const ui64 KEY_SOURCE_ID_FLAG = 1ULL << 63;
+	const ui64 KEY_ANY_VALUE_TYPE = 0x7F;
+	const ui64 KEY_ANY_SOURCE = 0xFF;
+	const ui64 KEY_ANY_TYPE = 0xFFFF;
+	const ui64 KEY_ANY_SUBTYPE = 0xFFFFFFFF;
+
+	ui64 packKey(ui64 type, ui64 subtype, ui64 source, ui64 valType)
+	{
+		return (valType << 56) | (source << 48) | (type << 32) | subtype;
+	}
+}
+
+BonusList::BonusList()
 {
 
 }
@@ -94,30 +114,23 @@ BonusList::BonusList(const BonusList &bonusList)
 {
 	bonuses.resize(bonusList.size());
 	std::copy(bonusList.begin(), bonusList.end(), bonuses.begin());
-	belongsToTree = false;
 }
 
-BonusList::BonusList(BonusList&& other):
-	belongsToTree(false)
+BonusList::BonusList(BonusList&& other)
 {
-	std::swap(belongsToTree, other.belongsToTree);
 	std::swap(bonuses, other.bonuses);
+	std::swap(typeOrder, other.typeOrder);
+	std::swap(buckets, other.buckets);
 }
 
 BonusList& BonusList::operator=(const BonusList &bonusList)
 {
+	changed();
 	bonuses.resize(bonusList.size());
 	std::copy(bonusList.begin(), bonusList.end(), bonuses.begin());
-	belongsToTree = false;
 	return *this;
 }
 
-void BonusList::changed()
-{
-    if(belongsToTree)
-		CBonusSystemNode::treeHasChanged();
-}
-
 int BonusList::totalValue() const
 {
 	int base = 0;
@@ -128,6 +141,7 @@ int BonusList::totalValue() const
 	bool hasIndepMax = false;
 	int indepMin = 0;
 	bool hasIndepMin = false;
+	bool notIndepBonuses = false;
 
 	for (auto& b : bonuses)
 	{
@@ -135,15 +149,19 @@ int BonusList::totalValue() const
 		{
 		case Bonus::BASE_NUMBER:
 			base += b->val;
+			notIndepBonuses = true;
 			break;
 		case Bonus::PERCENT_TO_ALL:
 			percentToAll += b->val;
+			notIndepBonuses = true;
 			break;
 		case Bonus::PERCENT_TO_BASE:
 			percentToBase += b->val;
+			notIndepBonuses = true;
 			break;
 		case Bonus::ADDITIVE_VALUE:
 			additive += b->val;
+			notIndepBonuses = true;
 			break;
 		case Bonus::INDEPENDENT_MAX:
 			if (!hasIndepMax)
@@ -178,11 +196,6 @@ int BonusList::totalValue() const
 	if(hasIndepMin && hasIndepMax)
 		assert(indepMin < indepMax);
 
-	const int notIndepBonuses = boost::count_if(bonuses, [](const std::shared_ptr<Bonus>& b)
-	{
-		return b->valType != Bonus::INDEPENDENT_MAX && b->valType != Bonus::INDEPENDENT_MIN;
-	});
-
 	if (hasIndepMax)
 	{
 		if(notIndepBonuses)
@@ -211,8 +224,68 @@ std::shared_ptr<Bonus> BonusList::getFirst(const CSelector &select)
 	return nullptr;
 }
 
+template <typename Func>
+void BonusList::forEachIndexed(const CSelector &selector, Func f) const
+{
+	auto visitBucket = [&](si32 type) -> bool
+	{
+		auto it = boost::lower_bound(buckets, std::make_pair(type, ui32(0)));
+		if(it == buckets.end() || it->first != type)
+			return true;
+
+		const ui32 end = (it + 1 == buckets.end()) ? typeOrder.size() : (it + 1)->second;
+		for(ui32 i = it->second; i < end; i++)
+			if(!f(bonuses[typeOrder[i]]))
+				return false;
+		return true;
+	};
+
+	const auto &terms = selector.getTerms();
+	const si32 firstType = terms.front().type;
+	if(std::all_of(terms.begin(), terms.end(), [=](const CSelector::Term &t){ return t.type == firstType; }))
+	{
+		visitBucket(firstType);
+		return;
+	}
+
+	//several types: gather their positions and visit them in list order
+	std::vector<si32> types;
+	for(auto & term : terms)
+		types.push_back(term.type);
+	boost::sort(types);
+	types.erase(std::unique(types.begin(), types.end()), types.end());
+
+	std::vector<ui32> positions;
+	for(si32 type : types)
+	{
+		auto it = boost::lower_bound(buckets, std::make_pair(type, ui32(0)));
+		if(it == buckets.end() || it->first != type)
+			continue;
+		const ui32 end = (it + 1 == buckets.end()) ? typeOrder.size() : (it + 1)->second;
+		positions.insert(positions.end(), typeOrder.begin() + it->second, typeOrder.begin() + end);
+	}
+	boost::sort(positions);
+
+	for(ui32 position : positions)
+		if(!f(bonuses[position]))
+			return;
+}
+
 const std::shared_ptr<Bonus> BonusList::getFirst(const CSelector &selector) const
 {
+	if(isGroupedByType() && selector.restrictsType())
+	{
+		std::shared_ptr<Bonus> ret;
+		forEachIndexed(selector, [&](const std::shared_ptr<Bonus> &b) -> bool
+		{
+			if(!selector(b.get()))
+				return true;
+			ret = b;
+			return false;
+		});
+		return ret;
+	}
+
 	for (auto & b : bonuses)
 	{
 		if(selector(b.get()))
@@ -228,12 +301,22 @@ void BonusList::getBonuses(BonusList & out, const CSelector &selector) const
 
 void BonusList::getBonuses(BonusList & out, const CSelector &selector, const CSelector &limit) const
 {
-	for (auto & b : bonuses)
+	auto accept = [&](const std::shared_ptr<Bonus> &b) -> bool
 	{
 		//add matching bonuses that matches limit predicate or have NO_LIMIT if no given predicate
 		if(selector(b.get()) && ((!limit && b->effectRange == Bonus::NO_LIMIT) || ((bool)limit && limit(b.get()))))
 			out.push_back(b);
+		return true;
+	};
+
+	if(isGroupedByType() && selector.restrictsType())
+	{
+		forEachIndexed(selector, accept);
+		return;
 	}
+
+	for (auto & b : bonuses)
+		accept(b);
 }
 
 void BonusList::getAllBonuses(BonusList &out) const
@@ -255,6 +338,25 @@ void BonusList::eliminateDuplicates()
 {
 	sort( bonuses.begin(), bonuses.end() );
 	bonuses.erase( unique( bonuses.begin(), bonuses.end() ), bonuses.end() );
+	changed();
+}
+
+void BonusList::groupByType()
+{
+	typeOrder.resize(bonuses.size());
+	std::iota(typeOrder.begin(), typeOrder.end(), 0);
+	boost::stable_sort(typeOrder, [this](ui32 a, ui32 b)
+	{
+		return bonuses[a]->type < bonuses[b]->type;
+	});
+
+	buckets.clear();
+	for(ui32 i = 0; i < typeOrder.size(); i++)
+	{
+		const si32 type = bonuses[typeOrder[i]]->type;
+		if(buckets.empty() || buckets.back().first != type)
+			buckets.push_back(std::make_pair(type, i));
+	}
 }
 
 void BonusList::push_back(std::shared_ptr<Bonus> x)
@@ -304,14 +406,7 @@ int IBonusBearer::valOfBonuses(Bonus::BonusType type, const CSelector &selector)
 
 int IBonusBearer::valOfBonuses(Bonus::BonusType type, int subtype /*= -1*/) const
 {
-	std::stringstream cachingStr;
-	cachingStr << "type_" << type << "s_" << subtype;
-
-	CSelector s = Selector::type(type);
-	if(subtype != -1)
-		s = s.And(Selector::subtype(subtype));
-
-	return valOfBonuses(s, cachingStr.str());
+	return valOfBonuses(BonusCacheKey::type(type, subtype));
 }
 
 int IBonusBearer::valOfBonuses(const CSelector &selector, const std::string &cachingStr) const
@@ -332,14 +427,7 @@ bool IBonusBearer::hasBonus(const CSelector &selector, const CSelector &limit, c
 
 bool IBonusBearer::hasBonusOfType(Bonus::BonusType type, int subtype /*= -1*/) const
 {
-	std::stringstream cachingStr;
-	cachingStr << "type_" << type << "s_" << subtype;
-
-	CSelector s = Selector::type(type);
-	if(subtype != -1)
-		s = s.And(Selector::subtype(subtype));
-
-	return hasBonus(s, cachingStr.str());
+	return hasBonus(BonusCacheKey::type(type, subtype));
 }
 
 const TBonusListPtr IBonusBearer::getBonuses(const CSelector &selector, const std::string &cachingStr /*= ""*/) const
@@ -354,9 +442,22 @@ const TBonusListPtr IBonusBearer::getBonuses(const CSelector &selector, const CS
 
 bool IBonusBearer::hasBonusFrom(Bonus::BonusSource source, ui32 sourceID) const
 {
-	std::stringstream cachingStr;
-	cachingStr << "source_" << source << "id_" << sourceID;
-	return hasBonus(Selector::source(source,sourceID), cachingStr.str());
+	return hasBonus(BonusCacheKey::source(source, sourceID));
+}
+
+const TBonusListPtr IBonusBearer::getBonusesByKey(const BonusCacheKey &key) const
+{
+	return getAllBonuses(key.selector(), nullptr);
+}
+
+int IBonusBearer::valOfBonuses(const BonusCacheKey &key) const
+{
+	return getBonusesByKey(key)->totalValue();
+}
+
+bool IBonusBearer::hasBonus(const BonusCacheKey &key) const
+{
+	return !getBonusesByKey(key)->empty();
 }
 
 int IBonusBearer::MoraleVal() const
@@ -419,15 +520,15 @@ ui32 IBonusBearer::MaxHealth() const
 
 ui32 IBonusBearer::getMinDamage() const
 {
-	std::stringstream cachingStr;
-	cachingStr << "type_" << Bonus::CREATURE_DAMAGE << "s_0Otype_" << Bonus::CREATURE_DAMAGE << "s_1";
-	return valOfBonuses(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 0).Or(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 1)), cachingStr.str());
+	static const std::string cachingStr = boost::str(boost::format("type_%ds_0Otype_%ds_1") % Bonus::CREATURE_DAMAGE % Bonus::CREATURE_DAMAGE);
+	static const CSelector selector = Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 0).Or(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 1));
+	return valOfBonuses(selector, cachingStr);
 }
 ui32 IBonusBearer::getMaxDamage() const
 {
-	std::stringstream cachingStr;
-	cachingStr << "type_" << Bonus::CREATURE_DAMAGE << "s_0Otype_" << Bonus::CREATURE_DAMAGE << "s_2";
-	return valOfBonuses(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 0).Or(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 2)), cachingStr.str());
+	static const std::string cachingStr = boost::str(boost::format("type_%ds_0Otype_%ds_2") % Bonus::CREATURE_DAMAGE % Bonus::CREATURE_DAMAGE);
+	static const CSelector selector = Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 0).Or(Selector::typeSubtype(Bonus::CREATURE_DAMAGE, 2));
+	return valOfBonuses(selector, cachingStr);
 }
 
 si32 IBonusBearer::manaLimit() const
@@ -458,6 +559,14 @@ si32 IBonusBearer::magicResistance() const
 
 ui32 IBonusBearer::Speed( int turn /*= 0*/ , bool useBind /* = false*/) const
 {
+	if(turn <= 0) //every bonus lasts zero turns -> turn selector can be skipped and keyed cache used
+	{
+		if(hasBonusOfType(Bonus::SIEGE_WEAPON) || (useBind && hasBonusOfType(Bonus::BIND_EFFECT)))
+			return 0;
+
+		return valOfBonuses(Bonus::STACKS_SPEED);
+	}
+
 	//war machines cannot move
 	if(hasBonus(Selector::type(Bonus::SIEGE_WEAPON).And(Selector::turns(turn))))
 	{
@@ -474,11 +583,9 @@ ui32 IBonusBearer::Speed( int turn /*= 0*/ , bool useBind /* = false*/) const
 
 bool IBonusBearer::isLiving() const //TODO: theoreticaly there exists "LIVING" bonus in stack experience documentation
 {
-	std::stringstream cachingStr;
-	cachingStr << "type_" << Bonus::UNDEAD << "s_-1Otype_" << Bonus::NON_LIVING << "s_-11type_" << Bonus::SIEGE_WEAPON; //I don't really get what string labels mean?
-	return !hasBonus(Selector::type(Bonus::UNDEAD)
-					.Or(Selector::type(Bonus::NON_LIVING))
-					.Or(Selector::type(Bonus::SIEGE_WEAPON)), cachingStr.str());
+	return !hasBonusOfType(Bonus::UNDEAD)
+		&& !hasBonusOfType(Bonus::NON_LIVING)
+		&& !hasBonusOfType(Bonus::SIEGE_WEAPON);
 }
 
 const std::shared_ptr<Bonus> IBonusBearer::getBonus(const CSelector &selector) const
@@ -552,23 +659,9 @@ const TBonusListPtr CBonusSystemNode::getAllBonuses(const CSelector &selector, c
 	if (CBonusSystemNode::cachingEnabled && limitOnUs)
 	{
 		// Exclusive access for one thread
-		static boost::mutex m;
-		boost::mutex::scoped_lock lock(m);
-
-		// If the bonus system tree changes(state of a single node or the relations to each other) then
-		// cache all bonus objects. Selector objects doesn't matter.
-		if (cachedLast != treeChanged)
-		{
-			cachedBonuses.clear();
-			cachedRequests.clear();
+		boost::mutex::scoped_lock lock(cachingMutex);
 
-			BonusList allBonuses;
-			getAllBonusesRec(allBonuses);
-			allBonuses.eliminateDuplicates();
-			limitBonuses(allBonuses, cachedBonuses);
-
-			cachedLast = treeChanged;
-		}
+		updateCachedBonuses();
 
 		// If a bonus system request comes with a caching string then look up in the map if there are any
 		// pre-calculated bonus results. Limiters can't be cached so they have to be calculated.
@@ -578,8 +671,10 @@ const TBonusListPtr CBonusSystemNode::getAllBonuses(const CSelector &selector, c
 			if(it != cachedRequests.end())
 			{
 				//Cached list contains bonuses for our query with applied limiters
+				cachingStats.requestHits++;
 				return it->second;
 			}
+			cachingStats.requestMisses++;
 		}
 
 		//We still don't have the bonuses (didn't returned them from cache)
@@ -599,6 +694,55 @@ const TBonusListPtr CBonusSystemNode::getAllBonuses(const CSelector &selector, c
 	}
 }
 
+const TBonusListPtr CBonusSystemNode::getBonusesByKey(const BonusCacheKey &key) const
+{
+	if(!CBonusSystemNode::cachingEnabled)
+		return getAllBonusesWithoutCaching(key.selector(), nullptr);
+
+	boost::mutex::scoped_lock lock(cachingMutex);
+
+	updateCachedBonuses();
+
+	auto it = cachedKeyRequests.find(key.value());
+	if(it != cachedKeyRequests.end())
+	{
+		cachingStats.requestHits++;
+		return it->second;
+	}
+	cachingStats.requestMisses++;
+
+	auto ret = std::make_shared<BonusList>();
+	cachedBonuses.getBonuses(*ret, key.selector(), nullptr);
+	cachedKeyRequests[key.value()] = ret;
+	return ret;
+}
+
+void CBonusSystemNode::updateCachedBonuses() const
+{
+	// If this node or any of its ancestors changed (state of a single node or the relations to each other)
+	// then cache all bonus objects. Selector objects doesn't matter.
+	if (cachedLast != treeChanged || cachedLastNode != nodeChanged)
+	{
+		cachedBonuses.clear();
+		cachedRequests.clear();
+		cachedKeyRequests.clear();
+
+		BonusList allBonuses;
+		getAllBonusesRec(allBonuses);
+		allBonuses.eliminateDuplicates();
+		limitBonuses(allBonuses, cachedBonuses);
+		cachedBonuses.groupByType();
+
+		cachedLast = treeChanged;
+		cachedLastNode = nodeChanged;
+		cachingStats.treeMisses++;
+	}
+	else
+	{
+		cachingStats.treeHits++;
+	}
+}
+
 const TBonusListPtr CBonusSystemNode::getAllBonusesWithoutCaching(const CSelector &selector, const CSelector &limit, const CBonusSystemNode *root /*= nullptr*/) const
 {
 	auto ret = std::make_shared<BonusList>();
@@ -635,7 +779,7 @@ const TBonusListPtr CBonusSystemNode::getAllBonusesWithoutCaching(const CSelecto
 	return ret;
 }
 
-CBonusSystemNode::CBonusSystemNode() : bonuses(true), exportedBonuses(true), nodeType(UNKNOWN), cachedLast(0)
+CBonusSystemNode::CBonusSystemNode() : nodeType(UNKNOWN), cachedLast(0), cachedLastNode(0), nodeChanged(0)
 {
 }
 
@@ -644,7 +788,9 @@ CBonusSystemNode::CBonusSystemNode(CBonusSystemNode && other):
 	exportedBonuses(std::move(other.exportedBonuses)),
 	nodeType(other.nodeType),
 	description(other.description),
-	cachedLast(0)
+	cachedLast(0),
+	cachedLastNode(0),
+	nodeChanged(0)
 {
 	std::swap(parents, other.parents);
 	std::swap(children, other.children);
@@ -667,6 +813,8 @@ CBonusSystemNode::CBonusSystemNode(CBonusSystemNode && other):
 
 	//cachedBonuses
 	//cachedRequests
+
+	nodeHasChanged();
 }
 
 CBonusSystemNode::~CBonusSystemNode()
@@ -691,7 +839,7 @@ void CBonusSystemNode::attachTo(CBonusSystemNode *parent)
 		newRedDescendant(parent);
 
 	parent->newChildAttached(this);
-	CBonusSystemNode::treeHasChanged();
+	nodeHasChanged();
 }
 
 void CBonusSystemNode::detachFrom(CBonusSystemNode *parent)
@@ -705,7 +853,7 @@ void CBonusSystemNode::detachFrom(CBonusSystemNode *parent)
 
 	parents -= parent;
 	parent->childDetached(this);
-	CBonusSystemNode::treeHasChanged();
+	nodeHasChanged();
 }
 
 void CBonusSystemNode::popBonuses(const CSelector &s)
@@ -728,6 +876,10 @@ void CBonusSystemNode::updateBonuses(const CSelector &s)
 		b->turnsRemain--;
 		if(b->turnsRemain <= 0)
 			removeBonus(b);
+		else if(b->propagator)
+			treeHasChanged(); //bonus may be held by nodes outside of our subtree
+		else
+			nodeHasChanged();
 	}
 
 	for(CBonusSystemNode *child : children)
@@ -745,7 +897,6 @@ void CBonusSystemNode::addNewBonus(const std::shared_ptr<Bonus>& b)
 	assert(!vstd::contains(exportedBonuses, b));
 	exportedBonuses.push_back(b);
 	exportBonus(b);
-	CBonusSystemNode::treeHasChanged();
 }
 
 void CBonusSystemNode::accumulateBonus(const std::shared_ptr<Bonus>& b)
@@ -763,8 +914,10 @@ void CBonusSystemNode::removeBonus(const std::shared_ptr<Bonus>& b)
 	if(b->propagator)
 		unpropagateBonus(b);
 	else
+	{
 		bonuses -= b;
-	CBonusSystemNode::treeHasChanged();
+		nodeHasChanged();
+	}
 }
 
 bool CBonusSystemNode::actsAsBonusSourceOnly() const
@@ -785,6 +938,7 @@ void CBonusSystemNode::propagateBonus(std::shared_ptr<Bonus> b)
 	if(b->propagator->shouldBeAttached(this))
 	{
 		bonuses.push_back(b);
+		nodeHasChanged();
 		BONUS_LOG_LINE("#$# " << b->Description() << " #propagated to# " << nodeName());
 	}
 
@@ -802,6 +956,7 @@ void CBonusSystemNode::unpropagateBonus(std::shared_ptr<Bonus> b)
 			logBonus->errorStream() << "Bonus was duplicated (" << b->Description() << ") at " << nodeName();
 			bonuses -= b;
 		}
+		nodeHasChanged();
 		BONUS_LOG_LINE("#$#" << b->Description() << " #is no longer propagated to# " << nodeName());
 	}
 
@@ -929,9 +1084,10 @@ void CBonusSystemNode::exportBonus(std::shared_ptr<Bonus> b)
 	if(b->propagator)
 		propagateBonus(b);
 	else
+	{
 		bonuses.push_back(b);
-
-	CBonusSystemNode::treeHasChanged();
+		nodeHasChanged();
+	}
 }
 
 void CBonusSystemNode::exportBonuses()
@@ -1022,11 +1178,41 @@ TBonusListPtr CBonusSystemNode::limitBonuses(const BonusList &allBonuses) const
 	return ret;
 }
 
+void CBonusSystemNode::nodeHasChanged()
+{
+	invalidateChildrenCache(++lastNodeChange);
+}
+
+void CBonusSystemNode::invalidateChildrenCache(si64 changeStamp)
+{
+	if(nodeChanged == changeStamp)
+		return; //already reached through another parent
+
+	nodeChanged = changeStamp;
+	for(CBonusSystemNode *child : children)
+		child->invalidateChildrenCache(changeStamp);
+}
+
 void CBonusSystemNode::treeHasChanged()
 {
 	treeChanged++;
 }
 
+CBonusSystemNode::CachingStats CBonusSystemNode::getCachingStats()
+{
+	boost::mutex::scoped_lock lock(cachingMutex);
+	CachingStats ret = cachingStats;
+	ret.treeChanges = treeChanged - treeChangedAtReset;
+	return ret;
+}
+
+void CBonusSystemNode::resetCachingStats()
+{
+	boost::mutex::scoped_lock lock(cachingMutex);
+	cachingStats = {0, 0, 0, 0, 0};
+	treeChangedAtReset = treeChanged;
+}
+
 int NBonus::valOf(const CBonusSystemNode *obj, Bonus::BonusType type, int subtype /*= -1*/)
 {
 	if(obj)
@@ -1120,8 +1306,16 @@ namespace Selector
 	DLL_LINKAGE CSelectFieldEqual<si32> info(&Bonus::additionalInfo);
 	DLL_LINKAGE CSelectFieldEqual<Bonus::BonusSource> sourceType(&Bonus::source);
 	DLL_LINKAGE CSelectFieldEqual<Bonus::LimitEffect> effectRange(&Bonus::effectRange);
-	DLL_LINKAGE CWillLastTurns turns;
-	DLL_LINKAGE CWillLastDays days;
+
+	CSelector DLL_LINKAGE turns(int Turns)
+	{
+		return CWillLastTurns(Turns);
+	}
+
+	CSelector DLL_LINKAGE days(int Days)
+	{
+		return CWillLastDays(Days);
+	}
 
 	CSelector DLL_LINKAGE typeSubtype(Bonus::BonusType Type, TBonusSubtype Subtype)
 	{
@@ -1146,8 +1340,8 @@ namespace Selector
 		return CSelectFieldEqual<Bonus::BonusSource>(&Bonus::source)(source);
 	}
 
-	DLL_LINKAGE CSelector all([](const Bonus * b){return true;});
-	DLL_LINKAGE CSelector none([](const Bonus * b){return false;});
+	DLL_LINKAGE CSelector all = CSelector::fromTerms(CSelector::TTerms(1));
+	DLL_LINKAGE CSelector none = CSelector::fromTerms(CSelector::TTerms());
 
 	bool DLL_LINKAGE matchesType(const CSelector &sel, Bonus::BonusType type)
 	{
@@ -1165,6 +1359,238 @@ namespace Selector
 	}
 }
 
+CSelector::Term::Term()
+	: fields(0), type(0), subtype(0), source(0), info(0), effectRange(0), valType(0), sid(0)
+{
+}
+
+bool CSelector::Term::conjoin(const Term &other)
+{
+	auto merge = [&](EField field, si32 &mine, si32 theirs) -> bool
+	{
+		if(!(other.fields & field))
+			return true;
+		if((fields & field) && mine != theirs)
+			return false;
+		fields |= field;
+		mine = theirs;
+		return true;
+	};
+
+	if(!merge(TYPE, type, other.type) || !merge(SUBTYPE, subtype, other.subtype) || !merge(SOURCE, source, other.source)
+		|| !merge(INFO, info, other.info) || !merge(EFFECT_RANGE, effectRange, other.effectRange) || !merge(VALUE_TYPE, valType, other.valType))
+		return false;
+
+	if(other.fields & SOURCE_ID)
+	{
+		if((fields & SOURCE_ID) && sid != other.sid)
+			return false;
+		fields |= SOURCE_ID;
+		sid = other.sid;
+	}
+
+	vstd::concatenate(predicates, other.predicates);
+	return true;
+}
+
+CSelector CSelector::fromTerm(Term Term)
+{
+	CSelector ret;
+	if(Term.predicates.empty())
+	{
+		ret.hasSingleTerm = true;
+		ret.singleTerm = std::move(Term);
+	}
+	else
+		ret.terms = std::make_shared<const TTerms>(1, std::move(Term));
+	return ret;
+}
+
+CSelector CSelector::fromTerms(TTerms Terms)
+{
+	if(Terms.size() == 1)
+		return fromTerm(std::move(Terms.front()));
+
+	static const auto noTerms = std::make_shared<const TTerms>();
+	CSelector ret;
+	ret.terms = Terms.empty() ? noTerms : std::make_shared<const TTerms>(std::move(Terms));
+	return ret;
+}
+
+CSelector::TTermsRange CSelector::getTerms() const
+{
+	if(hasSingleTerm)
+		return TTermsRange(&singleTerm, &singleTerm + 1);
+
+	assert(terms);
+	return TTermsRange(terms->data(), terms->data() + terms->size());
+}
+
+CSelector CSelector::fieldEqual(Bonus::BonusType Bonus::*ptr, const Bonus::BonusType &value)
+{
+	if(ptr != &Bonus::type)
+		return fieldEqual<Bonus::BonusType>(ptr, value);
+
+	Term term;
+	term.fields = TYPE;
+	term.type = value;
+	return fromTerm(term);
+}
+
+CSelector CSelector::fieldEqual(si32 Bonus::*ptr, const si32 &value)
+{
+	Term term;
+	if(ptr == &Bonus::subtype)
+	{
+		term.fields = SUBTYPE;
+		term.subtype = value;
+	}
+	else if(ptr == &Bonus::additionalInfo)
+	{
+		term.fields = INFO;
+		term.info = value;
+	}
+	else
+		return fieldEqual<si32>(ptr, value);
+
+	return fromTerm(term);
+}
+
+CSelector CSelector::fieldEqual(ui32 Bonus::*ptr, const ui32 &value)
+{
+	if(ptr != &Bonus::sid)
+		return fieldEqual<ui32>(ptr, value);
+
+	Term term;
+	term.fields = SOURCE_ID;
+	term.sid = value;
+	return fromTerm(term);
+}
+
+CSelector CSelector::fieldEqual(Bonus::BonusSource Bonus::*ptr, const Bonus::BonusSource &value)
+{
+	if(ptr != &Bonus::source)
+		return fieldEqual<Bonus::BonusSource>(ptr, value);
+
+	Term term;
+	term.fields = SOURCE;
+	term.source = value;
+	return fromTerm(term);
+}
+
+CSelector CSelector::fieldEqual(Bonus::LimitEffect Bonus::*ptr, const Bonus::LimitEffect &value)
+{
+	if(ptr != &Bonus::effectRange)
+		return fieldEqual<Bonus::LimitEffect>(ptr, value);
+
+	Term term;
+	term.fields = EFFECT_RANGE;
+	term.effectRange = value;
+	return fromTerm(term);
+}
+
+CSelector CSelector::And(CSelector rhs) const
+{
+	//(a1 | a2) & (b1 | b2) = a1&b1 | a1&b2 | a2&b1 | a2&b2, contradicting terms are dropped
+	const size_t MAX_TERMS = 16;
+	assert(*this && rhs);
+	const auto lhsTerms = getTerms(), rhsTerms = rhs.getTerms();
+
+	if(lhsTerms.size() == 1 && rhsTerms.size() == 1)
+	{
+		//most common case, like type and subtype, kept free of allocations
+		Term term = lhsTerms.front();
+		if(!term.conjoin(rhsTerms.front()))
+			return fromTerms(TTerms());
+		return fromTerm(std::move(term));
+	}
+
+	TTerms ret;
+	if(lhsTerms.size() * rhsTerms.size() > MAX_TERMS)
+	{
+		//too many combinations, test rhs as a whole
+		ret.assign(lhsTerms.begin(), lhsTerms.end());
+		for(auto & term : ret)
+			term.predicates.push_back([rhs](const Bonus *b){ return rhs(b); });
+		return fromTerms(std::move(ret));
+	}
+
+	for(auto & lhsTerm : lhsTerms)
+	{
+		for(auto & rhsTerm : rhsTerms)
+		{
+			Term term = lhsTerm;
+			if(term.conjoin(rhsTerm))
+				ret.push_back(std::move(term));
+		}
+	}
+	return fromTerms(std::move(ret));
+}
+
+CSelector CSelector::Or(CSelector rhs) const
+{
+	assert(*this && rhs);
+	const auto lhsTerms = getTerms(), rhsTerms = rhs.getTerms();
+
+	TTerms ret(lhsTerms.begin(), lhsTerms.end());
+	ret.insert(ret.end(), rhsTerms.begin(), rhsTerms.end());
+	return fromTerms(std::move(ret));
+}
+
+bool CSelector::restrictsType() const
+{
+	if(!*this)
+		return false;
+	const auto range = getTerms();
+	return !range.empty() && std::all_of(range.begin(), range.end(), [](const Term &t){ return t.fields & TYPE; });
+}
+
+BonusCacheKey BonusCacheKey::type(Bonus::BonusType type, TBonusSubtype subtype /*= -1*/)
+{
+	return BonusCacheKey(packKey(type, subtype == -1 ? KEY_ANY_SUBTYPE : static_cast<ui32>(subtype), KEY_ANY_SOURCE, KEY_ANY_VALUE_TYPE));
+}
+
+BonusCacheKey BonusCacheKey::source(Bonus::BonusSource source, ui32 sourceID)
+{
+	return BonusCacheKey(KEY_SOURCE_ID_FLAG | packKey(KEY_ANY_TYPE, sourceID, source, KEY_ANY_VALUE_TYPE));
+}
+
+CSelector BonusCacheKey::selector() const
+{
+	CSelector::Term term;
+	const ui64 type = (key >> 32) & KEY_ANY_TYPE;
+	const ui64 subtype = key & KEY_ANY_SUBTYPE;
+	const ui64 source = (key >> 48) & KEY_ANY_SOURCE;
+	const ui64 valType = (key >> 56) & KEY_ANY_VALUE_TYPE;
+
+	if(type != KEY_ANY_TYPE)
+	{
+		term.fields |= CSelector::TYPE;
+		term.type = type;
+	}
+	if(key & KEY_SOURCE_ID_FLAG)
+	{
+		term.fields |= CSelector::SOURCE_ID;
+		term.sid = subtype;
+	}
+	else if(subtype != KEY_ANY_SUBTYPE)
+	{
+		term.fields |= CSelector::SUBTYPE;
+		term.subtype = static_cast<TBonusSubtype>(subtype);
+	}
+	if(source != KEY_ANY_SOURCE)
+	{
+		term.fields |= CSelector::SOURCE;
+		term.source = source;
+	}
+	if(valType != KEY_ANY_VALUE_TYPE)
+	{
+		term.fields |= CSelector::VALUE_TYPE;
+		term.valType = valType;
+	}
+	return CSelector::fromTerm(term);
+}
+
 const CStack * retreiveStackBattle(const CBonusSystemNode *node)
 {
 	switch(node->getNodeType())
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "GameConstants.h"
 
 /*
@@ -18,6 +19,7 @@ class CBonusSystemNode;
 class ILimiter;
 class IPropagator;
 class BonusList;
+class CSelector;
 
 typedef std::shared_ptr<BonusList> TBonusListPtr;
 typedef std::shared_ptr<ILimiter> TLimiterPtr;
@@ -26,46 +28,6 @@ typedef std::set<CBonusSystemNode*> TNodes;
 typedef std::set<const CBonusSystemNode*> TCNodes;
 typedef std::vector<CBonusSystemNode *> TNodesVector;
 
-class CSelector : std::function<bool(const Bonus*)>
-{
-	typedef std::function<bool(const Bonus*)> TBase;
-public:
-	CSelector() {}
-	template<typename T>
-	CSelector(const T &t,	//SFINAE trick -> include this c-tor in overload resolution only if parameter is class
-							//(includes functors, lambdas) or function. Without that VC is going mad about ambiguities.
-		typename std::enable_if < boost::mpl::or_ < std::is_class<T>, std::is_function<T >> ::value>::type *dummy = nullptr)
-		: TBase(t)
-	{}
-
-	CSelector(std::nullptr_t)
-	{}
-
-	CSelector And(CSelector rhs) const
-	{
-		//lambda may likely outlive "this" (it can be even a temporary) => we copy the OBJECT (not pointer)
-		auto thisCopy = *this;
-		return [thisCopy, rhs](const Bonus *b) mutable { return thisCopy(b) && rhs(b); };
-	}
-	CSelector Or(CSelector rhs) const
-	{
-		auto thisCopy = *this;
-		return [thisCopy, rhs](const Bonus *b) mutable { return thisCopy(b) || rhs(b); };
-	}
-
-	bool operator()(const Bonus *b) const
-	{
-		return TBase::operator()(b);
-	}
-
-	operator bool() const
-	{
-		return !!static_cast<const TBase&>(*this);
-	}
-};
-
-
-
 #define BONUS_TREE_DESERIALIZATION_FIX if(!h.saving && h.smartPointerSerialization) deserializationFix();
 
 #define BONUS_LIST										\
@@ -387,6 +349,133 @@ struct DLL_LINKAGE Bonus : public std::enable_shared_from_this<Bonus>
 
 DLL_LINKAGE std::ostream & operator<<(std::ostream &out, const Bonus &bonus);
 
+/// Bonus predicate kept in inspectable form: disjunction of terms, each term is a conjunction of field
+/// equality tests and (optionally) opaque predicates. Field tests are evaluated without indirect calls
+/// and allow BonusList to pick only bonuses of the selected types.
+/// Single term without predicates (like Selector::type or its conjunction with other field tests) is stored inline,
+/// so building such selectors doesn't allocate; other terms are shared between copies.
+class DLL_LINKAGE CSelector
+{
+public:
+	enum EField
+	{
+		TYPE = 1, SUBTYPE = 2, SOURCE = 4, SOURCE_ID = 8, INFO = 16, EFFECT_RANGE = 32, VALUE_TYPE = 64
+	};
+
+	struct DLL_LINKAGE Term
+	{
+		ui8 fields; //EField mask of tested fields
+		si32 type, subtype, source, info, effectRange, valType;
+		ui32 sid;
+		std::vector<std::function<bool(const Bonus*)>> predicates; //opaque tests, all have to pass
+
+		Term();
+		bool conjoin(const Term &other); //returns false if terms contradict each other
+
+		bool matches(const Bonus *b) const
+		{
+			if(fields)
+			{
+				if((fields & TYPE) && b->type != type)
+					return false;
+				if((fields & SUBTYPE) && b->subtype != subtype)
+					return false;
+				if((fields & SOURCE) && b->source != source)
+					return false;
+				if((fields & SOURCE_ID) && b->sid != sid)
+					return false;
+				if((fields & INFO) && b->additionalInfo != info)
+					return false;
+				if((fields & EFFECT_RANGE) && b->effectRange != effectRange)
+					return false;
+				if((fields & VALUE_TYPE) && b->valType != valType)
+					return false;
+			}
+			for(auto & predicate : predicates)
+				if(!predicate(b))
+					return false;
+			return true;
+		}
+	};
+	typedef std::vector<Term> TTerms;
+	typedef boost::iterator_range<const Term *> TTermsRange;
+
+	CSelector() : hasSingleTerm(false) {}
+	template<typename T>
+	CSelector(const T &t,	//SFINAE trick -> include this c-tor in overload resolution only if parameter is class
+							//(includes functors, lambdas) or function. Without that VC is going mad about ambiguities.
+		typename std::enable_if < boost::mpl::or_ < std::is_class<T>, std::is_function<T >> ::value>::type *dummy = nullptr)
+		: hasSingleTerm(false)
+	{
+		Term term;
+		term.predicates.push_back(t);
+		terms = std::make_shared<TTerms>(1, term);
+	}
+
+	CSelector(std::nullptr_t)
+		: hasSingleTerm(false)
+	{}
+
+	static CSelector fromTerm(Term Term);
+	static CSelector fromTerms(TTerms Terms);
+
+	//selectors testing single field, recognized fields are kept inspectable
+	template<typename T>
+	static CSelector fieldEqual(T Bonus::*ptr, const T &value)
+	{
+		return [ptr, value](const Bonus *bonus) { return bonus->*ptr == value; };
+	}
+	static CSelector fieldEqual(Bonus::BonusType Bonus::*ptr, const Bonus::BonusType &value);
+	static CSelector fieldEqual(si32 Bonus::*ptr, const si32 &value);
+	static CSelector fieldEqual(ui32 Bonus::*ptr, const ui32 &value);
+	static CSelector fieldEqual(Bonus::BonusSource Bonus::*ptr, const Bonus::BonusSource &value);
+	static CSelector fieldEqual(Bonus::LimitEffect Bonus::*ptr, const Bonus::LimitEffect &value);
+
+	CSelector And(CSelector rhs) const;
+	CSelector Or(CSelector rhs) const;
+
+	bool operator()(const Bonus *b) const
+	{
+		if(hasSingleTerm)
+			return singleTerm.matches(b);
+
+		assert(terms);
+		for(auto & term : *terms)
+			if(term.matches(b))
+				return true;
+		return false;
+	}
+
+	operator bool() const
+	{
+		return hasSingleTerm || terms;
+	}
+
+	TTermsRange getTerms() const;
+	bool restrictsType() const; //every selected bonus has to be of type tested by one of terms
+
+private:
+	bool hasSingleTerm;
+	Term singleTerm; //used if hasSingleTerm is set
+	std::shared_ptr<const TTerms> terms; //otherwise: empty selector if null, matches nothing if there are no terms
+};
+
+/// Allocation-free identifier of a simple bonus request: (type, subtype, source, value type) packed into one integer.
+/// Used instead of cachingStr on hot paths, every field (except type) may be left as "any".
+class DLL_LINKAGE BonusCacheKey
+{
+	ui64 key;
+
+	explicit BonusCacheKey(ui64 Key) : key(Key) {}
+public:
+	static BonusCacheKey type(Bonus::BonusType type, TBonusSubtype subtype = -1); //subtype -1 means any subtype
+	static BonusCacheKey source(Bonus::BonusSource source, ui32 sourceID); //any type
+
+	CSelector selector() const; //selector matching same bonuses
+
+	ui64 value() const { return key; }
+};
+
 
 class DLL_LINKAGE BonusList
 {
@@ -395,8 +484,13 @@ public:
 
 private:
 	TInternalContainer bonuses;
-	bool belongsToTree;
-	void changed();
+
+	// Indexed mode: positions of bonuses ordered by type (and by position within type), bonuses themselves keep their order.
+	// Each present type has a bucket (type, first index in typeOrder), bucket ends where next one starts. Empty if list is in plain mode.
+	std::vector<ui32> typeOrder;
+	std::vector<std::pair<si32, ui32>> buckets;
+	void changed() { if(!buckets.empty()) { buckets.clear(); typeOrder.clear(); } }
+	template <typename Func> void forEachIndexed(const CSelector &selector, Func f) const; //f returns false to stop
 
 public:
 	typedef TInternalContainer::const_reference const_reference;
@@ -405,7 +499,7 @@ public:
 	typedef TInternalContainer::const_iterator const_iterator;
 	typedef TInternalContainer::iterator iterator;
 
-	BonusList(bool BelongsToTree = false);
+	BonusList();
 	BonusList(const BonusList &bonusList);
 	BonusList(BonusList && other);
 	BonusList& operator=(const BonusList &bonusList);
@@ -417,10 +511,10 @@ public:
 	void clear();
 	bool empty() const { return bonuses.empty(); }
 	void resize(TInternalContainer::size_type sz, std::shared_ptr<Bonus> c = nullptr );
-	std::shared_ptr<Bonus> &operator[] (TInternalContainer::size_type n) { return bonuses[n]; }
+	std::shared_ptr<Bonus> &operator[] (TInternalContainer::size_type n) { changed(); return bonuses[n]; }
 	const std::shared_ptr<Bonus> &operator[] (TInternalContainer::size_type n) const { return bonuses[n]; }
-	std::shared_ptr<Bonus> &back() { return bonuses.back(); }
-	std::shared_ptr<Bonus> &front() { return bonuses.front(); }
+	std::shared_ptr<Bonus> &back() { changed(); return bonuses.back(); }
+	std::shared_ptr<Bonus> &front() { changed(); return bonuses.front(); }
 	const std::shared_ptr<Bonus> &back() const { return bonuses.back(); }
 	const std::shared_ptr<Bonus> &front() const { return bonuses.front(); }
 
@@ -443,6 +537,10 @@ public:
 
 	void eliminateDuplicates();
 
+	///builds index used by type restricted selectors, any modification of list returns to plain mode; order of bonuses is kept
+	void groupByType();
+	bool isGroupedByType() const { return !buckets.empty(); }
+
 	// remove_if implementation for STL vector types
 	template <class Predicate>
 	void remove_if(Predicate pred)
@@ -457,6 +555,7 @@ public:
 		bonuses.clear();
 		bonuses.resize(newList.size());
 		std::copy(newList.begin(), newList.end(), bonuses.begin());
+		changed();
 	}
 
 	template <class InputIterator>
@@ -467,16 +566,19 @@ public:
 	void serialize(Handler &h, const int version)
 	{
 		h & static_cast<TInternalContainer&>(bonuses);
+		changed();
 	}
 
 	// C++ for range support
 	auto begin () -> decltype (bonuses.begin())
 	{
+		changed();
 		return bonuses.begin();
 	}
 
 	auto end () -> decltype (bonuses.end())
 	{
+		changed();
 		return bonuses.end();
 	}
 };
@@ -566,6 +668,11 @@ public:
 
 	const std::shared_ptr<Bonus> getBonus(const CSelector &selector) const; //returns any bonus visible on node that matches (or nullptr if none matches)
 
+	//keyed interface, doesn't build selectors nor caching strings
+	virtual const TBonusListPtr getBonusesByKey(const BonusCacheKey &key) const;
+	int valOfBonuses(const BonusCacheKey &key) const;
+	bool hasBonus(const BonusCacheKey &key) const;
+
 	//legacy interface
 	int valOfBonuses(Bonus::BonusType type, const CSelector &selector) const;
 	int valOfBonuses(Bonus::BonusType type, int subtype = -1) const; //subtype -> subtype of bonus, if -1 then anyt;
@@ -609,18 +716,35 @@ private:
 	static const bool cachingEnabled;
 	mutable BonusList cachedBonuses;
 	mutable int cachedLast;
-	static int treeChanged;
+	mutable si64 cachedLastNode;
+	static std::atomic<int> treeChanged;
+
+	// Stamp of the last change in this node or any of its ancestors. Changes are propagated only
+	// downwards (to children), so caches of unrelated nodes stay valid.
+	si64 nodeChanged;
+	static std::atomic<si64> lastNodeChange; //nodes of separate trees (like simulated battles) may change concurrently
 
 	// Setting a value to cachingStr before getting any bonuses caches the result for later requests.
 	// This string needs to be unique, that's why it has to be setted in the following manner:
 	// [property key]_[value] => only for selector
 	mutable std::map<std::string, TBonusListPtr > cachedRequests;
+	// Same for requests made by BonusCacheKey, hashed by packed key value
+	mutable std::unordered_map<ui64, TBonusListPtr> cachedKeyRequests;
 
+	void updateCachedBonuses() const; //requires cache lock
 	void getBonusesRec(BonusList &out, const CSelector &selector, const CSelector &limit) const;
 	void getAllBonusesRec(BonusList &out) const;
 	const TBonusListPtr getAllBonusesWithoutCaching(const CSelector &selector, const CSelector &limit, const CBonusSystemNode *root = nullptr) const;
+	void invalidateChildrenCache(si64 changeStamp);
 
 public:
+	struct CachingStats
+	{
+		ui64 treeHits, treeMisses; //whole (limited) bonus tree of node reused / collected again
+		ui64 requestHits, requestMisses; //results of cachingStr requests reused / selected again
+		ui64 treeChanges; //treeHasChanged() calls, each makes every node collect its tree again
+	};
+
 	explicit CBonusSystemNode();
 	CBonusSystemNode(CBonusSystemNode && other);
 	virtual ~CBonusSystemNode();
@@ -628,6 +752,7 @@ public:
 	void limitBonuses(const BonusList &allBonuses, BonusList &out) const; //out will bo populed with bonuses that are not limited here
 	TBonusListPtr limitBonuses(const BonusList &allBonuses) const; //same as above, returns out by val for convienence
 	const TBonusListPtr getAllBonuses(const CSelector &selector, const CSelector &limit, const CBonusSystemNode *root = nullptr, const std::string &cachingStr = "") const override;
+	const TBonusListPtr getBonusesByKey(const BonusCacheKey &key) const override;
 	void getParents(TCNodes &out) const;  //retrieves list of parent nodes (nodes to inherit bonuses from),
 	const std::shared_ptr<Bonus> getBonusLocalFirst(const CSelector &selector) const;
 
@@ -675,8 +800,14 @@ public:
 	const std::string &getDescription() const;
 	void setDescription(const std::string &description);
 
+	///invalidates cached bonuses of this node and all its descendants
+	void nodeHasChanged();
+	///invalidates cached bonuses of every node, needed when bonuses are modified in place
 	static void treeHasChanged();
 
+	static CachingStats getCachingStats();
+	static void resetCachingStats();
+
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
 		h & /*bonuses & */nodeType;
@@ -707,8 +838,7 @@ public:
 
 	CSelector operator()(const T &valueToCompareAgainst) const
 	{
-		auto ptr2 = ptr; //We need a COPY because we don't want to reference this (might be outlived by lambda)
-		return [ptr2, valueToCompareAgainst](const Bonus *bonus) {  return bonus->*ptr2 == valueToCompareAgainst; };
+		return CSelector::fieldEqual(ptr, valueToCompareAgainst);
 	}
 };
 
@@ -738,17 +868,16 @@ class DLL_LINKAGE CWillLastTurns
 public:
 	int turnsRequested;
 
+	explicit CWillLastTurns(int TurnsRequested)
+		: turnsRequested(TurnsRequested)
+	{
+	}
 	bool operator()(const Bonus *bonus) const
 	{
 		return turnsRequested <= 0					//every present effect will last zero (or "less") turns
 			|| !Bonus::NTurns(bonus) //so do every not expriing after N-turns effect
 			|| bonus->turnsRemain > turnsRequested;
 	}
-	CWillLastTurns& operator()(const int &setVal)
-	{
-		turnsRequested = setVal;
-		return *this;
-	}
 };
 
 class DLL_LINKAGE CWillLastDays
@@ -756,6 +885,10 @@ class DLL_LINKAGE CWillLastDays
 public:
 	int daysRequested;
 
+	explicit CWillLastDays(int DaysRequested)
+		: daysRequested(DaysRequested)
+	{
+	}
 	bool operator()(const Bonus *bonus) const
 	{
 		if(daysRequested <= 0 || Bonus::Permanent(bonus) || Bonus::OneBattle(bonus))
@@ -769,11 +902,6 @@ public:
 
 		return false; // TODO: ONE_WEEK need support for turnsRemain, but for now we'll exclude all unhandled durations
 	}
-	CWillLastDays& operator()(const int &setVal)
-	{
-		daysRequested = setVal;
-		return *this;
-	}
 };
 
 //Stores multiple limiters. If any of them fails -> bonus is dropped.
@@ -911,8 +1039,8 @@ namespace Selector
 	extern DLL_LINKAGE CSelectFieldEqual<si32> info;
 	extern DLL_LINKAGE CSelectFieldEqual<Bonus::BonusSource> sourceType;
 	extern DLL_LINKAGE CSelectFieldEqual<Bonus::LimitEffect> effectRange;
-	extern DLL_LINKAGE CWillLastTurns turns;
-	extern DLL_LINKAGE CWillLastDays days;
+	CSelector DLL_LINKAGE turns(int turns); //selectors keep their own copy of the count, so they can be made from several threads
+	CSelector DLL_LINKAGE days(int days);
 
 	CSelector DLL_LINKAGE typeSubtype(Bonus::BonusType Type, TBonusSubtype Subtype);
 	CSelector DLL_LINKAGE typeSubtypeInfo(Bonus::BonusType type, TBonusSubtype subtype, si32 info);
@@ -21,6 +21,7 @@
 #include "serializer/BinaryDeserializer.h"
 #include "serializer/BinarySerializer.h"
 #include "serializer/CLoadIntegrityValidator.h"
+#include "serializer/CGameStateSnapshots.h"
 #include "rmg/CMapGenOptions.h"
 #include "mapping/CCampaignHandler.h"
 #include "mapObjects/CObjectClassesHandler.h"
@@ -152,6 +153,16 @@ CGameState * CPrivilagedInfoCallback::gameState ()
 	return gs;
 }
 
+static boost::filesystem::path getSaveDirectory(const CLoadFile & in)
+{
+	return boost::filesystem::path(in.fName).parent_path();
+}
+
+static boost::filesystem::path getSaveDirectory(const CLoadIntegrityValidator & in)
+{
+	return getSaveDirectory(*in.primaryFile);
+}
+
 template<typename Loader>
 void CPrivilagedInfoCallback::loadCommonState(Loader &in)
 {
@@ -167,6 +178,23 @@ void CPrivilagedInfoCallback::loadCommonState(Loader &in)
 	logGlobal->infoStream() << "\tReading options";
 	in.serializer & si;
 
+	bool delta = false;
+	if(in.serializer.fileVersion >= 765)
+		in.serializer & delta;
+	if(delta)
+	{
+		std::string snapshotName;
+		in.serializer & snapshotName;
+		auto snapshotPath = CGameStateSnapshots::getSnapshotPath(getSaveDirectory(in), snapshotName);
+		logGlobal->infoStream() << "\tReading snapshot " << snapshotPath;
+		{
+			CLoadFile snapshot(snapshotPath, MINIMAL_SERIALIZATION_VERSION);
+			loadCommonState(snapshot);
+		}
+		gs->snapshots->loadDelta(in.serializer, snapshotPath);
+		return;
+	}
+
 	logGlobal->infoStream() <<"\tReading handlers";
 	in.serializer & *VLC;
 
@@ -175,7 +203,7 @@ void CPrivilagedInfoCallback::loadCommonState(Loader &in)
 }
 
 template<typename Saver>
-void CPrivilagedInfoCallback::saveCommonState(Saver &out) const
+ui32 CPrivilagedInfoCallback::saveCommonState(Saver &out) const
 {
 	logGlobal->infoStream() << "Saving lib part of game...";
 	out.putMagicBytes(SAVEGAME_MAGIC);
@@ -183,16 +211,25 @@ void CPrivilagedInfoCallback::saveCommonState(Saver &out) const
 	out.serializer & static_cast<CMapHeader&>(*gs->map);
 	logGlobal->infoStream() << "\tSaving options";
 	out.serializer & gs->scenarioOps;
+	ui32 saveId;
+	if(gs->snapshots->saveDelta(out, saveId))
+		return saveId;
 	logGlobal->infoStream() << "\tSaving handlers";
 	out.serializer & *VLC;
 	logGlobal->infoStream() << "\tSaving gamestate";
 	out.serializer & gs;
+	return saveId;
+}
+
+void CPrivilagedInfoCallback::saveFinished(const boost::filesystem::path & fname, ui32 saveId)
+{
+	gs->snapshots->saveFinished(fname, saveId);
 }
 
 // hardly memory usage for `-gdwarf-4` flag
 template DLL_LINKAGE void CPrivilagedInfoCallback::loadCommonState<CLoadIntegrityValidator>(CLoadIntegrityValidator&);
 template DLL_LINKAGE void CPrivilagedInfoCallback::loadCommonState<CLoadFile>(CLoadFile&);
-template DLL_LINKAGE void CPrivilagedInfoCallback::saveCommonState<CSaveFile>(CSaveFile&) const;
+template DLL_LINKAGE ui32 CPrivilagedInfoCallback::saveCommonState<CSaveFile>(CSaveFile&) const;
 
 TerrainTile * CNonConstInfoCallback::getTile( int3 pos )
 {
@@ -37,7 +37,8 @@ public:
 	void getAllowedSpells(std::vector<SpellID> &out, ui16 level);
 
 	template<typename Saver>
-	void saveCommonState(Saver &out) const; //stores GS and VLC
+	ui32 saveCommonState(Saver &out) const; //stores GS and VLC, or changes since the last full savegame; returns id for saveFinished
+	void saveFinished(const boost::filesystem::path & fname, ui32 saveId); //call once savegame file is closed
 
 	template<typename Loader>
 	void loadCommonState(Loader &in); //loads GS and VLC
@@ -386,6 +386,24 @@ struct PlayerEndsGame : public CPackForClient
 	}
 };
 
+struct PlayerCheated : public CPackForClient
+{
+	PlayerCheated() : losingCheatCode(false), winningCheatCode(false)
+	{
+	}
+
+	DLL_LINKAGE void applyGs(CGameState *gs);
+
+	PlayerColor player;
+	bool losingCheatCode;
+	bool winningCheatCode;
+
+	template <typename Handler> void serialize(Handler &h, const int version)
+	{
+		h & player & losingCheatCode & winningCheatCode;
+	}
+};
+
 struct RemoveBonus :  public CPackForClient
 {
 	RemoveBonus(ui8 Who = 0)
@@ -539,6 +557,8 @@ struct RemoveObject : public CPackForClient
 
 	ObjectInstanceID id;
 
+	std::vector<int3> affectedTiles; //used locally, filled in applyFirstCl
+
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
 		h & id;
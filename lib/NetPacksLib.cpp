@@ -350,6 +350,13 @@ DLL_LINKAGE void PlayerEndsGame::applyGs(CGameState *gs)
 	else p->status = EPlayerStatus::LOSER;
 }
 
+DLL_LINKAGE void PlayerCheated::applyGs(CGameState *gs)
+{
+	PlayerState *p = gs->getPlayer(player);
+	if(losingCheatCode) p->enteredLosingCheatCode = true;
+	if(winningCheatCode) p->enteredWinningCheatCode = true;
+}
+
 DLL_LINKAGE void RemoveBonus::applyGs(CGameState *gs)
 {
 	CBonusSystemNode *node;
@@ -1256,6 +1263,8 @@ DLL_LINKAGE void BattleNextRound::applyGs(CGameState *gs)
 
 	for(auto &obst : gs->curB->obstacles)
 		obst->battleTurnPassed();
+
+	gs->curB->stateChanged();
 }
 
 DLL_LINKAGE void BattleSetActiveStack::applyGs(CGameState *gs)
@@ -1308,12 +1317,16 @@ DLL_LINKAGE void BattleTriggerEffect::applyGs(CGameState *gs)
 DLL_LINKAGE void BattleObstaclePlaced::applyGs(CGameState *gs)
 {
 	gs->curB->obstacles.push_back(obstacle);
+	gs->curB->stateChanged();
 }
 
 DLL_LINKAGE void BattleUpdateGateState::applyGs(CGameState *gs)
 {
 	if(gs->curB)
+	{
 		gs->curB->si.gateState = state;
+		gs->curB->stateChanged();
+	}
 }
 
 void BattleResult::applyGs(CGameState *gs)
@@ -1380,6 +1393,7 @@ void BattleStackMoved::applyGs(CGameState *gs)
 		}
 	}
 	s->position = dest;
+	gs->curB->stateChanged();
 }
 
 DLL_LINKAGE void BattleStackAttacked::applyGs(CGameState *gs)
@@ -1431,6 +1445,8 @@ DLL_LINKAGE void BattleStackAttacked::applyGs(CGameState *gs)
 	{
 		at->makeGhost();
 	}
+
+	gs->curB->stateChanged();
 }
 
 DLL_LINKAGE void BattleAttack::applyGs(CGameState *gs)
@@ -1519,6 +1535,7 @@ DLL_LINKAGE void BattleSpellCast::applyGs(CGameState *gs)
 	const CSpell * spell = SpellID(id).toSpell();
 
 	spell->applyBattle(gs->curB, this);
+	gs->curB->stateChanged();
 }
 
 void actualizeEffect(CStack * s, const Bonus & ef)
@@ -1530,7 +1547,7 @@ void actualizeEffect(CStack * s, const Bonus & ef)
 			stackBonus->turnsRemain = std::max(stackBonus->turnsRemain, ef.turnsRemain);
 		}
 	}
-	CBonusSystemNode::treeHasChanged();
+	s->nodeHasChanged();
 }
 
 void actualizeEffect(CStack * s, const std::vector<Bonus> & ef)
@@ -1667,6 +1684,7 @@ DLL_LINKAGE void StacksHealedOrResurrected::applyGs(CGameState *gs)
 			};
 			changedStack->popBonuses(selector);
 		}
+		gs->curB->stateChanged();
 	}
 }
 
@@ -1685,6 +1703,7 @@ DLL_LINKAGE void ObstaclesRemoved::applyGs(CGameState *gs)
 				}
 			}
 		}
+		gs->curB->stateChanged();
 	}
 }
 
@@ -1707,6 +1726,7 @@ DLL_LINKAGE void CatapultAttack::applyGs(CGameState *gs)
 			gs->curB->si.wallState[it.attackedPart] =
 			        SiegeInfo::applyDamage(EWallState::EWallState(gs->curB->si.wallState[it.attackedPart]), it.damageDealt);
 		}
+		gs->curB->stateChanged();
 	}
 }
 
@@ -1767,6 +1787,7 @@ DLL_LINKAGE void BattleStacksRemoved::applyGs(CGameState *gs)
 
 		stackIDs.erase(rem_stack);
 	}
+	gs->curB->stateChanged();
 }
 
 DLL_LINKAGE void BattleStackAdded::applyGs(CGameState *gs)
@@ -1785,6 +1806,7 @@ DLL_LINKAGE void BattleStackAdded::applyGs(CGameState *gs)
 
 	gs->curB->localInitStack(addedStack);
 	gs->curB->stacks.push_back(addedStack); //the stack is not "SUMMONED", it is permanent
+	gs->curB->stateChanged();
 
 	newStackID = addedStack->ID;
 }
@@ -372,7 +372,9 @@ public:
 		int level = twoLevel ? 2 : 1;
 		if(h.saving)
 		{
-			// Save terrain
+			// Save terrain, guard positions follow as one block
+			std::vector<int3> guards;
+			guards.reserve(width * height * level);
 			for(int i = 0; i < width ; ++i)
 			{
 				for(int j = 0; j < height ; ++j)
@@ -380,10 +382,11 @@ public:
 					for(int k = 0; k < level; ++k)
 					{
 						h & terrain[i][j][k];
-						h & guardingCreaturePositions[i][j][k];
+						guards.push_back(guardingCreaturePositions[i][j][k]);
 					}
 				}
 			}
+			h & guards;
 		}
 		else
 		{
@@ -400,17 +403,37 @@ public:
 					guardingCreaturePositions[i][j] = new int3[level];
 				}
 			}
-			for(int i = 0; i < width ; ++i)
+			if(formatVersion < 764)
 			{
-				for(int j = 0; j < height ; ++j)
+				for(int i = 0; i < width ; ++i)
 				{
-					for(int k = 0; k < level; ++k)
+					for(int j = 0; j < height ; ++j)
 					{
-						h & terrain[i][j][k];
-						h & guardingCreaturePositions[i][j][k];
+						for(int k = 0; k < level; ++k)
+						{
+							h & terrain[i][j][k];
+							h & guardingCreaturePositions[i][j][k];
+						}
 					}
 				}
 			}
+			else
+			{
+				for(int i = 0; i < width ; ++i)
+					for(int j = 0; j < height ; ++j)
+						for(int k = 0; k < level; ++k)
+							h & terrain[i][j][k];
+
+				std::vector<int3> guards;
+				h & guards;
+				if(guards.size() != static_cast<size_t>(width * height * level))
+					throw std::runtime_error("Invalid guard positions in map data");
+				auto guard = guards.begin();
+				for(int i = 0; i < width ; ++i)
+					for(int j = 0; j < height ; ++j)
+						for(int k = 0; k < level; ++k)
+							guardingCreaturePositions[i][j][k] = *guard++;
+			}
 		}
 
 		h & objects;
@@ -307,6 +307,7 @@ void registerTypesClientPacks2(Serializer &s)
 
 	s.template registerType<CPackForClient, SaveGame>();
 	s.template registerType<CPackForClient, PlayerMessage>();
+	s.template registerType<CPackForClient, PlayerCheated>();
 }
 
 template<typename Serializer>
@@ -3,6 +3,10 @@
 
 #include "../registerTypes/RegisterTypes.h"
 
+#include <zlib.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
 /*
  * BinaryDeserializer.cpp, part of VCMI engine
  *
@@ -15,8 +19,45 @@
 
 extern template void registerTypes<BinaryDeserializer>(BinaryDeserializer & s);
 
+static const size_t COMPRESSION_CHUNK_SIZE = 64 * 1024;
+static const si32 FIRST_COMPRESSED_VERSION = 763;
+
+struct CLoadFile::MappedFile
+{
+	std::unique_ptr<boost::interprocess::file_mapping> mapping;
+	std::unique_ptr<boost::interprocess::mapped_region> region;
+	std::vector<ui8> data; //whole file, used if it can't be mapped
+	const ui8 * begin;
+	const ui8 * end;
+
+	explicit MappedFile(const boost::filesystem::path & fname)
+	{
+		try
+		{
+			mapping = make_unique<boost::interprocess::file_mapping>(fname.string().c_str(), boost::interprocess::read_only);
+			region = make_unique<boost::interprocess::mapped_region>(*mapping, boost::interprocess::read_only);
+			begin = static_cast<const ui8 *>(region->get_address());
+			end = begin + region->get_size();
+		}
+		catch(boost::interprocess::interprocess_exception &)
+		{
+			//empty files or paths not representable in narrow characters
+			region.reset();
+			mapping.reset();
+			FileStream stream(fname, std::ios::in | std::ios::binary);
+			if(!stream)
+				THROW_FORMAT("Error: cannot open to read %s!", fname.string());
+			stream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			data.resize(boost::filesystem::file_size(fname));
+			stream.read(reinterpret_cast<char *>(data.data()), data.size());
+			begin = data.data();
+			end = begin + data.size();
+		}
+	}
+};
+
 CLoadFile::CLoadFile(const boost::filesystem::path & fname, int minimalVersion /*= version*/)
-	: serializer(this)
+	: inflateState(nullptr), compressedPos(nullptr), compressedEnd(nullptr), windowStart(nullptr), windowOffset(0), serializer(this)
 {
 	registerTypes(serializer);
 	openNextFile(fname, minimalVersion);
@@ -24,32 +65,95 @@ CLoadFile::CLoadFile(const boost::filesystem::path & fname, int minimalVersion /
 
 CLoadFile::~CLoadFile()
 {
+	finishDecompression();
 }
 
 int CLoadFile::read(void * data, unsigned size)
 {
-	sfile->read((char*)data,size);
+	//called by deserializer only when window doesn't hold all the data
+	auto bytes = static_cast<ui8 *>(data);
+	unsigned done = 0;
+	while(done < size)
+	{
+		if(window == windowEnd)
+		{
+			if(!inflateState)
+				THROW_FORMAT("Error: unexpected end of file %s!", fName);
+			inflateMore();
+		}
+
+		unsigned toCopy = std::min<size_t>(size - done, windowEnd - window);
+		std::memcpy(bytes + done, window, toCopy);
+		window += toCopy;
+		done += toCopy;
+	}
 	return size;
 }
 
+ui64 CLoadFile::tell() const
+{
+	return windowOffset + (window - windowStart);
+}
+
+void CLoadFile::inflateMore()
+{
+	windowOffset += windowEnd - windowStart;
+	buffer.resize(COMPRESSION_CHUNK_SIZE);
+	inflateState->next_out = buffer.data();
+	inflateState->avail_out = buffer.size();
+	while(inflateState->avail_out == buffer.size())
+	{
+		if(inflateState->avail_in == 0)
+		{
+			if(compressedPos == compressedEnd)
+				THROW_FORMAT("Error: unexpected end of file %s!", fName);
+
+			//zlib takes the mapped data directly
+			size_t available = std::min<size_t>(compressedEnd - compressedPos, std::numeric_limits<uInt>::max());
+			inflateState->next_in = const_cast<Bytef *>(compressedPos);
+			inflateState->avail_in = available;
+			compressedPos += available;
+		}
+
+		int ret = inflate(inflateState, Z_NO_FLUSH);
+		if(ret == Z_STREAM_END && inflateState->avail_out == buffer.size())
+			THROW_FORMAT("Error: unexpected end of file %s!", fName);
+		if(ret != Z_OK && ret != Z_STREAM_END)
+			THROW_FORMAT("Error: corrupted data in file %s!", fName);
+	}
+	buffer.resize(buffer.size() - inflateState->avail_out);
+	windowStart = window = buffer.data();
+	windowEnd = window + buffer.size();
+}
+
+void CLoadFile::finishDecompression()
+{
+	if(inflateState)
+	{
+		inflateEnd(inflateState);
+		delete inflateState;
+		inflateState = nullptr;
+	}
+	buffer.clear();
+	compressedPos = compressedEnd = nullptr;
+}
+
 void CLoadFile::openNextFile(const boost::filesystem::path & fname, int minimalVersion)
 {
 	assert(!serializer.reverseEndianess);
 	assert(minimalVersion <= SERIALIZATION_VERSION);
+	clear();
 
 	try
 	{
 		fName = fname.string();
-		sfile = make_unique<FileStream>(fname, std::ios::in | std::ios::binary);
-		sfile->exceptions(std::ifstream::failbit | std::ifstream::badbit); //we throw a lot anyway
-
-		if(!(*sfile))
-			THROW_FORMAT("Error: cannot open to read %s!", fName);
+		mappedFile = make_unique<MappedFile>(fname);
+		windowStart = window = mappedFile->begin;
+		windowEnd = mappedFile->end;
 
 		//we can read
-		char buffer[4];
-		sfile->read(buffer, 4);
-		if(std::memcmp(buffer,"VCMI",4))
+		const ui8 * magic = serializer.borrow(4);
+		if(!magic || std::memcmp(magic, "VCMI", 4))
 			THROW_FORMAT("Error: not a VCMI file(%s)!", fName);
 
 		serializer & serializer.fileVersion;
@@ -72,6 +176,27 @@ void CLoadFile::openNextFile(const boost::filesystem::path & fname, int minimalV
 			else
 				THROW_FORMAT("Error: too new file format (%s)!", fName);
 		}
+
+		bool compressed = false;
+		if(serializer.fileVersion >= FIRST_COMPRESSED_VERSION)
+			serializer & compressed;
+
+		if(compressed)
+		{
+			inflateState = new z_stream_s();
+			if(inflateInit(inflateState) != Z_OK)
+			{
+				delete inflateState;
+				inflateState = nullptr;
+				THROW_FORMAT("Error: cannot initialize decompression for %s!", fName);
+			}
+
+			//rest of the mapping is compressed, deserializer reads from decompressed buffer
+			compressedPos = window;
+			compressedEnd = windowEnd;
+			windowOffset += window - windowStart;
+			windowStart = window = windowEnd = nullptr;
+		}
 	}
 	catch(...)
 	{
@@ -83,15 +208,18 @@ void CLoadFile::openNextFile(const boost::filesystem::path & fname, int minimalV
 void CLoadFile::reportState(CLogger * out)
 {
 	out->debugStream() << "CLoadFile";
-	if(!!sfile && *sfile)
+	if(mappedFile)
 	{
-		out->debugStream() << "\tOpened " << fName << "\n\tPosition: " << sfile->tellg();
+		out->debugStream() << "\tOpened " << fName << "\n\tPosition: " << tell();
 	}
 }
 
 void CLoadFile::clear()
 {
-	sfile = nullptr;
+	finishDecompression();
+	mappedFile.reset();
+	windowStart = window = windowEnd = nullptr;
+	windowOffset = 0;
 	fName.clear();
 	serializer.fileVersion = 0;
 }
@@ -16,6 +16,8 @@
 #include "CTypeList.h"
 #include "../mapObjects/CGHeroInstance.h"
 
+struct z_stream_s;
+
 class CStackInstance;
 
 class DLL_LINKAGE CLoaderBase
@@ -27,8 +29,24 @@ public:
 
 	inline int read(void * data, unsigned size)
 	{
+		if(size <= static_cast<size_t>(reader->windowEnd - reader->window))
+		{
+			std::memcpy(data, reader->window, size);
+			reader->window += size;
+			return size;
+		}
 		return reader->read(data, size);
 	};
+
+	/// Returns size bytes of reader's memory and skips them, nullptr if they aren't available in one piece
+	inline const ui8 * borrow(unsigned size)
+	{
+		if(size > static_cast<size_t>(reader->windowEnd - reader->window))
+			return nullptr;
+		const ui8 * ret = reader->window;
+		reader->window += size;
+		return ret;
+	}
 };
 
 /// Main class for deserialization of classes from binary form
@@ -162,8 +180,8 @@ public:
 	bool reverseEndianess; //if source has different endianness than us, we reverse bytes
 	si32 fileVersion;
 
-	std::map<ui32, void*> loadedPointers;
-	std::map<ui32, const std::type_info*> loadedPointersTypes;
+	std::vector<void*> loadedPointers; //indexed by pointer ID
+	std::vector<const std::type_info*> loadedPointersTypes;
 	std::map<const void*, boost::any> loadedSharedPointers;
 	bool smartPointerSerialization;
 	bool saving;
@@ -235,7 +253,7 @@ public:
 		range::copy(convData, data.begin());
 	}
 
-	template <typename T, typename std::enable_if < !std::is_same<T, bool >::value, int  >::type = 0>
+	template <typename T, typename std::enable_if < !std::is_same<T, bool >::value && !BulkSerializable<T>::value, int  >::type = 0>
 	void load(std::vector<T> &data)
 	{
 		READ_CHECK_U32(length);
@@ -244,6 +262,25 @@ public:
 			load( data[i]);
 	}
 
+	template <typename T, typename std::enable_if < BulkSerializable<T>::value, int  >::type = 0>
+	void load(std::vector<T> &data)
+	{
+		typedef typename BulkSerializable<T>::TField TField;
+		READ_CHECK_U32(length);
+		data.resize(length);
+		if(!length)
+			return;
+
+		char * dataPtr = reinterpret_cast<char *>(data.data());
+		char * dataEnd = dataPtr + length * sizeof(T);
+		this->read(dataPtr, dataEnd - dataPtr);
+		if(reverseEndianess)
+		{
+			for(char * field = dataPtr; field != dataEnd; field += sizeof(TField))
+				std::reverse(field, field + sizeof(TField));
+		}
+	}
+
 	template < typename T, typename std::enable_if < std::is_pointer<T>::value, int  >::type = 0 >
 	void load(T &data)
 	{
@@ -283,14 +320,11 @@ public:
 		if(smartPointerSerialization)
 		{
 			load( pid ); //get the id
-			std::map<ui32, void*>::iterator i = loadedPointers.find(pid); //lookup
-
-			if(i != loadedPointers.end())
+			if(pid < loadedPointers.size() && loadedPointers[pid])
 			{
 				// We already got this pointer
 				// Cast it in case we are loading it to a non-first base pointer
-				assert(loadedPointersTypes.count(pid));
-				data = reinterpret_cast<T>(typeList.castRaw(i->second, loadedPointersTypes.at(pid), &typeid(typename std::remove_const<typename std::remove_pointer<T>::type>::type)));
+				data = typeList.castFromMostDerived<typename std::remove_pointer<T>::type>(loadedPointers[pid], loadedPointersTypes[pid]);
 				return;
 			}
 		}
@@ -317,7 +351,7 @@ public:
 				return;
 			}
 			auto typeInfo = app->loadPtr(*this,&data, pid);
-			data = reinterpret_cast<T>(typeList.castRaw((void*)data, typeInfo, &typeid(typename std::remove_const<typename std::remove_pointer<T>::type>::type)));
+			data = typeList.castFromMostDerived<typename std::remove_pointer<T>::type>((void*)data, typeInfo);
 		}
 	}
 
@@ -326,8 +360,16 @@ public:
 	{
 		if(smartPointerSerialization && pid != 0xffffffff)
 		{
+			//IDs are given sequentially when saving, so the arrays stay dense; anything else is corrupted data
+			if(pid > loadedPointers.size())
+				throw std::runtime_error("Pointer ID " + boost::lexical_cast<std::string>(pid) + " is out of sequence");
+			if(pid == loadedPointers.size())
+			{
+				loadedPointers.resize(pid + 1, nullptr);
+				loadedPointersTypes.resize(pid + 1, nullptr);
+			}
 			loadedPointersTypes[pid] = &typeid(T);
-			loadedPointers[pid] = (void*)ptr; //add loaded pointer to our lookup map; cast is to avoid errors with const T* pt
+			loadedPointers[pid] = (void*)ptr; //add loaded pointer to our lookup table; cast is to avoid errors with const T* pt
 		}
 	}
 
@@ -474,6 +516,11 @@ public:
 	void load(std::string &data)
 	{
 		READ_CHECK_U32(length);
+		if(auto bytes = this->borrow(length))
+		{
+			data.assign(reinterpret_cast<const char *>(bytes), length);
+			return;
+		}
 		data.resize(length);
 		this->read((void*)data.c_str(),length);
 	}
@@ -509,17 +556,31 @@ public:
 	}
 };
 
+/// Reads savegame mapped to memory. Deserializer copies data directly from the mapping,
+/// or from the decompression buffer if the file is compressed, so loading makes no system calls.
 class DLL_LINKAGE CLoadFile : public IBinaryReader
 {
+	struct MappedFile;
+	std::unique_ptr<MappedFile> mappedFile;
+
+	z_stream_s * inflateState; //set if file is compressed
+	std::vector<ui8> buffer; //decompressed data
+	const ui8 * compressedPos; //compressed data not yet passed to zlib
+	const ui8 * compressedEnd;
+	const ui8 * windowStart; //mapped file or decompressed buffer
+	ui64 windowOffset; //position of windowStart in the data
+
+	void inflateMore(); //refills buffer, throws at end of data
+	void finishDecompression();
 public:
 	BinaryDeserializer serializer;
 
 	std::string fName;
-	std::unique_ptr<FileStream> sfile;
 
 	CLoadFile(const boost::filesystem::path & fname, int minimalVersion = SERIALIZATION_VERSION); //throws!
 	~CLoadFile();
 	int read(void * data, unsigned size) override; //throws!
+	ui64 tell() const; //number of bytes read, counted in decompressed data
 
 	void openNextFile(const boost::filesystem::path & fname, int minimalVersion); //throws!
 	void clear();
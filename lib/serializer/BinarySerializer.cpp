@@ -2,6 +2,16 @@
 #include "BinarySerializer.h"
 
 #include "../registerTypes/RegisterTypes.h"
+#include "../CThreadHelper.h"
+
+#include <zlib.h>
+#ifdef VCMI_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /*
  * BinarySerializer.cpp, part of VCMI engine
@@ -15,8 +25,33 @@
 
 extern template void registerTypes<BinarySerializer>(BinarySerializer & s);
 
-CSaveFile::CSaveFile(const boost::filesystem::path &fname)
-	: serializer(this)
+static const size_t COMPRESSION_CHUNK_SIZE = 64 * 1024;
+static const size_t POINTER_TABLE_INITIAL_SIZE = 256;
+
+CPointerIdTable::CPointerIdTable()
+	: entries(POINTER_TABLE_INITIAL_SIZE), count(0)
+{
+}
+
+void CPointerIdTable::grow()
+{
+	std::vector<Entry> old(entries.size() * 2);
+	old.swap(entries);
+	for(auto & entry : old)
+	{
+		if(entry.ptr)
+			entries[slotFor(entry.ptr)] = entry;
+	}
+}
+
+void CPointerIdTable::clear()
+{
+	entries.assign(POINTER_TABLE_INITIAL_SIZE, Entry());
+	count = 0;
+}
+
+CSaveFile::CSaveFile(const boost::filesystem::path &fname, bool Compressed, bool Background)
+	: compressed(Compressed), background(Background), deflateState(nullptr), serializer(this)
 {
 	registerTypes(serializer);
 	openNextFile(fname);
@@ -24,17 +59,103 @@ CSaveFile::CSaveFile(const boost::filesystem::path &fname)
 
 CSaveFile::~CSaveFile()
 {
+	try
+	{
+		close();
+	}
+	catch(std::exception & e)
+	{
+		logGlobal->errorStream() << "Failed to finish writing " << fName << ": " << e.what();
+	}
 }
 
 int CSaveFile::write(const void * data, unsigned size)
 {
-	sfile->write((char *)data,size);
+	if(background)
+	{
+		auto bytes = static_cast<const ui8 *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+		return size;
+	}
+
+	if(!deflateState)
+	{
+		sfile->write((char *)data,size);
+		return size;
+	}
+
+	//zlib is called for big chunks only, serializer writes mostly few bytes at once
+	auto bytes = static_cast<const ui8 *>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+	if(buffer.size() >= COMPRESSION_CHUNK_SIZE)
+		deflateBuffer(false);
 	return size;
 }
 
+void CSaveFile::deflateBuffer(bool finish)
+{
+	deflateState->next_in = buffer.data();
+	deflateState->avail_in = buffer.size();
+	int ret;
+	do
+	{
+		deflateState->next_out = compressedBuffer.data();
+		deflateState->avail_out = compressedBuffer.size();
+		ret = deflate(deflateState, finish ? Z_FINISH : Z_NO_FLUSH);
+		if(ret == Z_STREAM_ERROR)
+			THROW_FORMAT("Error: failed to compress data for %s!", fName);
+		sfile->write((char *)compressedBuffer.data(), compressedBuffer.size() - deflateState->avail_out);
+	}
+	while(deflateState->avail_out == 0 || (finish && ret != Z_STREAM_END));
+	buffer.clear();
+}
+
+void CSaveFile::finishCompression()
+{
+	if(!deflateState)
+		return;
+
+	z_stream_s * state = deflateState;
+	try
+	{
+		if(sfile)
+			deflateBuffer(true);
+	}
+	catch(...)
+	{
+		deflateEnd(state);
+		delete state;
+		deflateState = nullptr;
+		throw;
+	}
+	deflateEnd(state);
+	delete state;
+	deflateState = nullptr;
+}
+
+void CSaveFile::close(std::function<void(bool)> onWritten)
+{
+	if(background)
+	{
+		if(!fName.empty())
+			CBackgroundSaveWriter::get().write(fName, compressed, std::move(buffer), onWritten);
+		clear();
+		return;
+	}
+
+	finishCompression();
+	sfile.reset();
+	if(onWritten)
+		onWritten(true);
+}
+
 void CSaveFile::openNextFile(const boost::filesystem::path &fname)
 {
+	close();
 	fName = fname;
+	if(background)
+		return; //header is written by the writer thread
+
 	try
 	{
 		sfile = make_unique<FileStream>(fname, std::ios::out | std::ios::binary);
@@ -45,6 +166,20 @@ void CSaveFile::openNextFile(const boost::filesystem::path &fname)
 
 		sfile->write("VCMI",4); //write magic identifier
 		serializer & SERIALIZATION_VERSION; //write format version
+		serializer & compressed;
+
+		if(compressed)
+		{
+			//fast level, savegames are written during the game
+			deflateState = new z_stream_s();
+			if(deflateInit(deflateState, Z_BEST_SPEED) != Z_OK)
+			{
+				delete deflateState;
+				deflateState = nullptr;
+				THROW_FORMAT("Error: cannot initialize compression for %s!", fname);
+			}
+			compressedBuffer.resize(COMPRESSION_CHUNK_SIZE);
+		}
 	}
 	catch(...)
 	{
@@ -65,6 +200,13 @@ void CSaveFile::reportState(CLogger * out)
 
 void CSaveFile::clear()
 {
+	if(deflateState)
+	{
+		deflateEnd(deflateState);
+		delete deflateState;
+		deflateState = nullptr;
+	}
+	buffer.clear();
 	fName.clear();
 	sfile = nullptr;
 }
@@ -73,3 +215,118 @@ void CSaveFile::putMagicBytes(const std::string &text)
 {
 	write(text.c_str(), text.length());
 }
+
+CBackgroundSaveWriter::CBackgroundSaveWriter()
+	: busy(false), terminating(false)
+{
+	thread = boost::thread(&CBackgroundSaveWriter::writerLoop, this);
+}
+
+CBackgroundSaveWriter::~CBackgroundSaveWriter()
+{
+	{
+		boost::unique_lock<boost::mutex> lock(mx);
+		terminating = true;
+	}
+	cond.notify_all();
+	thread.join();
+}
+
+CBackgroundSaveWriter & CBackgroundSaveWriter::get()
+{
+	static CBackgroundSaveWriter writer;
+	return writer;
+}
+
+void CBackgroundSaveWriter::write(const boost::filesystem::path & fname, bool compressed, std::vector<ui8> data, std::function<void(bool)> onWritten)
+{
+	Job job;
+	job.fname = fname;
+	job.compressed = compressed;
+	job.data = std::move(data);
+	job.onWritten = onWritten;
+
+	boost::unique_lock<boost::mutex> lock(mx);
+	jobs.push_back(std::move(job));
+	cond.notify_all();
+}
+
+void CBackgroundSaveWriter::waitForAll()
+{
+	boost::unique_lock<boost::mutex> lock(mx);
+	cond.wait(lock, [this](){ return jobs.empty() && !busy; });
+}
+
+void CBackgroundSaveWriter::writerLoop()
+{
+	setThreadName("CBackgroundSaveWriter::writerLoop");
+	while(true)
+	{
+		Job job;
+		{
+			boost::unique_lock<boost::mutex> lock(mx);
+			cond.wait(lock, [this](){ return terminating || !jobs.empty(); });
+			if(jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			busy = true;
+		}
+
+		bool success = true;
+		try
+		{
+			writeFile(job);
+			logGlobal->infoStream() << "Savegame " << job.fname << " has been written";
+		}
+		catch(std::exception & e)
+		{
+			logGlobal->errorStream() << "Failed to write " << job.fname << ": " << e.what();
+			success = false;
+		}
+
+		try
+		{
+			if(job.onWritten)
+				job.onWritten(success);
+		}
+		catch(std::exception & e)
+		{
+			logGlobal->errorStream() << "Error after writing " << job.fname << ": " << e.what();
+		}
+
+		boost::unique_lock<boost::mutex> lock(mx);
+		busy = false;
+		cond.notify_all();
+	}
+}
+
+static void syncFile(const boost::filesystem::path & fname)
+{
+#ifdef VCMI_WINDOWS
+	int fd = _wopen(fname.c_str(), _O_RDWR | _O_BINARY);
+	if(fd < 0 || _commit(fd) != 0)
+		THROW_FORMAT("Error: cannot flush %s to disk!", fname);
+	_close(fd);
+#else
+	int fd = open(fname.c_str(), O_RDONLY);
+	if(fd < 0 || fsync(fd) != 0)
+		THROW_FORMAT("Error: cannot flush %s to disk!", fname);
+	::close(fd);
+#endif
+}
+
+void CBackgroundSaveWriter::writeFile(const Job & job)
+{
+	//old savegame stays intact until new one is completely written
+	auto temporary = job.fname;
+	temporary += ".tmp";
+	{
+		CSaveFile file(temporary, job.compressed);
+		if(!job.data.empty())
+			file.write(job.data.data(), job.data.size());
+		file.close();
+	}
+	syncFile(temporary);
+	boost::filesystem::rename(temporary, job.fname);
+}
@@ -14,6 +14,8 @@
 #include "CTypeList.h"
 #include "../mapObjects/CArmedInstance.h"
 
+struct z_stream_s;
+
 class DLL_LINKAGE CSaverBase
 {
 protected:
@@ -27,6 +29,58 @@ public:
 	};
 };
 
+/// Hash table with open addressing that gives sequential IDs to saved pointers
+class DLL_LINKAGE CPointerIdTable
+{
+	struct Entry
+	{
+		const void * ptr; //nullptr in empty slots
+		ui32 id;
+	};
+
+	std::vector<Entry> entries; //size is a power of 2
+	size_t count;
+
+	size_t slotFor(const void * ptr) const
+	{
+		//objects are aligned, so low bits of address carry no information
+		size_t hash = reinterpret_cast<size_t>(ptr) >> 3;
+		hash ^= hash >> 16;
+		hash *= 0x45d9f3b;
+		hash ^= hash >> 16;
+
+		size_t mask = entries.size() - 1;
+		size_t slot = hash & mask;
+		while(entries[slot].ptr && entries[slot].ptr != ptr)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	void grow();
+public:
+	CPointerIdTable();
+
+	const ui32 * find(const void * ptr) const
+	{
+		const Entry & entry = entries[slotFor(ptr)];
+		return entry.ptr ? &entry.id : nullptr;
+	}
+
+	ui32 insert(const void * ptr) //pointer must not be in the table yet, returns its new ID
+	{
+		if((count + 1) * 2 > entries.size())
+			grow();
+
+		Entry & entry = entries[slotFor(ptr)];
+		entry.ptr = ptr;
+		entry.id = count++;
+		return entry.id;
+	}
+
+	size_t size() const { return count; }
+	void clear();
+};
+
 /// Main class for serialization of classes into binary form
 /// Behaviour for various classes is following:
 /// Primitives:    copy memory into underlying stream (defined in CSaverBase)
@@ -109,7 +163,7 @@ class DLL_LINKAGE BinarySerializer : public CSaverBase
 	CApplier<CBasicPointerSaver> applier;
 
 public:
-	std::map<const void*, ui32> savedPointers;
+	CPointerIdTable savedPointers;
 
 	bool smartPointerSerialization;
 	bool saving;
@@ -203,33 +257,34 @@ public:
 				return;
 		}
 
+		//type of object and its address are looked up once per static and dynamic type
+		const auto & typeInfo = typeList.getDynamicTypeInfo(data);
+		auto actualPointer = reinterpret_cast<const char *>(data) + typeInfo.offset;
+
 		if(smartPointerSerialization)
 		{
 			// We might have an object that has multiple inheritance and store it via the non-first base pointer.
 			// Therefore, all pointers need to be normalized to the actual object address.
-			auto actualPointer = typeList.castToMostDerived(data);
-			std::map<const void*,ui32>::iterator i = savedPointers.find(actualPointer);
-			if(i != savedPointers.end())
+			if(const ui32 * id = savedPointers.find(actualPointer))
 			{
 				//this pointer has been already serialized - write only it's id
-				save(i->second);
+				save(*id);
 				return;
 			}
 
 			//give id to this pointer
-			ui32 pid = (ui32)savedPointers.size();
-			savedPointers[actualPointer] = pid;
+			ui32 pid = savedPointers.insert(actualPointer);
 			save(pid);
 		}
 
 		//write type identifier
-		ui16 tid = typeList.getTypeID(data);
+		ui16 tid = typeInfo.typeID;
 		save(tid);
 
 		if(!tid)
 			save(*data); //if type is unregistered simply write all data in a standard way
 		else
-			applier.getApplier(tid)->savePtr(*this, typeList.castToMostDerived(data));  //call serializer specific for our real type
+			applier.getApplier(tid)->savePtr(*this, actualPointer);  //call serializer specific for our real type
 	}
 
 	template < typename T, typename std::enable_if < is_serializeable<BinarySerializer, T>::value, int  >::type = 0 >
@@ -250,7 +305,7 @@ public:
 		T *internalPtr = data.get();
 		save(internalPtr);
 	}
-	template <typename T, typename std::enable_if < !std::is_same<T, bool >::value, int  >::type = 0>
+	template <typename T, typename std::enable_if < !std::is_same<T, bool >::value && !BulkSerializable<T>::value, int  >::type = 0>
 	void save(const std::vector<T> &data)
 	{
 		ui32 length = data.size();
@@ -258,6 +313,15 @@ public:
 		for(ui32 i=0;i<length;i++)
 			save(data[i]);
 	}
+	template <typename T, typename std::enable_if < BulkSerializable<T>::value, int  >::type = 0>
+	void save(const std::vector<T> &data)
+	{
+		static_assert(std::is_standard_layout<T>::value && sizeof(T) % sizeof(typename BulkSerializable<T>::TField) == 0, "Type can't be serialized in bulk");
+		ui32 length = data.size();
+		*this & length;
+		if(length)
+			this->write(data.data(), length * sizeof(T));
+	}
 	template <typename T, size_t N>
 	void save(const std::array<T, N> &data)
 	{
@@ -348,16 +412,26 @@ public:
 
 class DLL_LINKAGE CSaveFile : public IBinaryWriter
 {
+	bool compressed; //everything after format version goes through zlib
+	bool background; //data is kept in memory and written by CBackgroundSaveWriter on close
+	z_stream_s * deflateState; //set while compressed file is opened
+	std::vector<ui8> buffer; //data not yet passed to zlib, or all data after format version in background mode
+	std::vector<ui8> compressedBuffer;
+
+	void deflateBuffer(bool finish);
+	void finishCompression();
 public:
 	BinarySerializer serializer;
 
 	boost::filesystem::path fName;
 	std::unique_ptr<FileStream> sfile;
 
-	CSaveFile(const boost::filesystem::path &fname); //throws!
+	CSaveFile(const boost::filesystem::path &fname, bool Compressed = true, bool Background = false); //throws!
 	~CSaveFile();
 	int write(const void * data, unsigned size) override;
 
+	/// Finishes the file, onWritten is called once it is on disk. In background mode it's called from the writer thread.
+	void close(std::function<void(bool)> onWritten = nullptr); //throws!
 	void openNextFile(const boost::filesystem::path &fname); //throws!
 	void clear();
 	void reportState(CLogger * out) override;
@@ -371,3 +445,34 @@ public:
 		return * this;
 	}
 };
+
+/// Thread writing savegames serialized in memory, so compression, disk writes and syncing don't stop the game.
+/// Savegames are written in the order they were queued, each to a temporary file renamed once the data is on disk.
+class DLL_LINKAGE CBackgroundSaveWriter : boost::noncopyable
+{
+	struct Job
+	{
+		boost::filesystem::path fname;
+		bool compressed;
+		std::vector<ui8> data;
+		std::function<void(bool)> onWritten;
+	};
+
+	boost::mutex mx;
+	boost::condition_variable cond;
+	std::deque<Job> jobs;
+	bool busy; //job taken from the queue is being written
+	bool terminating;
+	boost::thread thread;
+
+	void writerLoop();
+	static void writeFile(const Job & job); //throws!
+public:
+	CBackgroundSaveWriter();
+	~CBackgroundSaveWriter(); //writes remaining savegames
+
+	static CBackgroundSaveWriter & get();
+
+	void write(const boost::filesystem::path & fname, bool compressed, std::vector<ui8> data, std::function<void(bool)> onWritten);
+	void waitForAll(); //blocks until every queued savegame is written
+};
@@ -0,0 +1,305 @@
+/*
+ * CGameStateSnapshots.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "CGameStateSnapshots.h"
+
+#include "../registerTypes/RegisterTypes.h"
+#include "../CGameState.h"
+#include "../NetPacks.h"
+#include "../StartInfo.h"
+#include "../rmg/CMapGenOptions.h"
+#include "../mapping/CCampaignHandler.h"
+#include "../mapping/CMap.h"
+
+static const std::string SNAPSHOT_EXTENSION = ".snapshot";
+static const si32 FIRST_DELTA_VERSION = 765;
+static const si32 FIRST_PACK_GENERATOR_VERSION = 766;
+static const size_t MAX_PENDING_JOURNAL_SIZE = 16 << 20; //full savegame is normally written long before, bounds the journal if it's never reported
+
+/// Resolves "." and ".." without touching the file system, so paths leading to the same snapshot compare equal
+static boost::filesystem::path normalizePath(const boost::filesystem::path & path)
+{
+	boost::filesystem::path ret;
+	for(const auto & part : path)
+	{
+		if(part == ".")
+			continue;
+		if(part == ".." && ret.has_filename() && ret.filename() != "..")
+			ret.remove_filename();
+		else
+			ret /= part;
+	}
+	return ret;
+}
+
+CGameStateSnapshots::CGameStateSnapshots(CGameState * GS)
+	: gs(GS), state(EState::NONE), savesCount(0), pendingSave(0), readPos(0), packsCount(0), generatorJournaled(false), snapshotSize(0), oser(this), iser(this)
+{
+	registerTypes(oser);
+	registerTypes(iser);
+	oser.smartPointerSerialization = false;
+	iser.smartPointerSerialization = false;
+	iser.fileVersion = SERIALIZATION_VERSION;
+}
+
+int CGameStateSnapshots::read(void * data, unsigned size)
+{
+	if(journal.size() < readPos + size)
+		throw std::runtime_error("Cannot read past the end of savegame journal");
+
+	std::memcpy(data, journal.data() + readPos, size);
+	readPos += size;
+	return size;
+}
+
+int CGameStateSnapshots::write(const void * data, unsigned size)
+{
+	auto bytes = static_cast<const ui8 *>(data);
+	journal.insert(journal.end(), bytes, bytes + size);
+	return size;
+}
+
+void CGameStateSnapshots::startJournal(EState newState)
+{
+	std::vector<ui8>().swap(journal);
+	readPos = 0;
+	packsCount = 0;
+	generatorJournaled = false;
+	state = newState;
+	if(state != EState::NONE)
+	{
+		//packs refer to objects by their IDs, like when sent to clients
+		addStdVecItems(gs);
+		sendStackInstanceByIds = true;
+	}
+}
+
+void CGameStateSnapshots::record(CPack * pack)
+{
+	boost::unique_lock<boost::mutex> lock(mx);
+	if(state == EState::NONE)
+		return;
+
+	oser & pack;
+	packsCount++;
+
+	//packs like NewObject draw from the generator, which is also used by server between packs
+	const TGenerator & generator = gs->getRandomGenerator().getStdGenerator();
+	bool generatorChanged = !generatorJournaled || generator != journaledGenerator;
+	oser & generatorChanged;
+	if(generatorChanged)
+	{
+		oser & gs->getRandomGenerator();
+		journaledGenerator = generator;
+		generatorJournaled = true;
+	}
+
+	if(state == EState::ACTIVE && journal.size() > snapshotSize)
+	{
+		logGlobal->debug("Savegame journal outgrew its snapshot, next savegame will be full");
+		startJournal(EState::NONE);
+	}
+	else if(state == EState::PENDING && journal.size() > MAX_PENDING_JOURNAL_SIZE)
+	{
+		logGlobal->warn("Full savegame was not finished, next savegame will be full");
+		startJournal(EState::NONE);
+	}
+}
+
+bool CGameStateSnapshots::saveDelta(CSaveFile & out, ui32 & saveId)
+{
+	boost::unique_lock<boost::mutex> lock(mx);
+	saveId = ++savesCount;
+	const std::string snapshotName = state == EState::ACTIVE ? getSnapshotReference(out.fName.parent_path(), snapshotPath) : "";
+	//battle is not part of savegame, replaying its packs would restore it
+	bool delta = !snapshotName.empty() && !gs->curB;
+
+	out.serializer & delta;
+	if(!delta)
+	{
+		//journal of the previous pending savegame is dropped, saveFinished ignores it
+		startJournal(gs->curB ? EState::NONE : EState::PENDING);
+		pendingSave = saveId;
+		return false;
+	}
+
+	logGlobal->info("\tSaving %d changes since snapshot %s", packsCount, snapshotName);
+	out.serializer & snapshotName & journal & packsCount;
+	out.serializer & gs->getRandomGenerator();
+	return true;
+}
+
+void CGameStateSnapshots::saveFinished(const boost::filesystem::path & fname, ui32 saveId)
+{
+	boost::unique_lock<boost::mutex> lock(mx);
+	if(state != EState::PENDING || saveId != pendingSave)
+		return;
+
+	try
+	{
+		auto directory = getSnapshotsDirectory(fname.parent_path());
+		boost::filesystem::create_directories(directory);
+
+		//savegame itself can be overwritten later, snapshot must stay as long as some delta savegame refers to it
+		const std::string prefix = fname.stem().string() + "_" + boost::lexical_cast<std::string>(std::time(nullptr));
+		boost::filesystem::path path;
+		for(int i = 0; path.empty() || boost::filesystem::exists(path); i++)
+			path = directory / (prefix + "_" + boost::lexical_cast<std::string>(i) + fname.extension().string() + SNAPSHOT_EXTENSION);
+
+		boost::filesystem::copy_file(fname, path);
+		snapshotPath = normalizePath(path);
+		snapshotSize = boost::filesystem::file_size(path);
+		state = EState::ACTIVE;
+	}
+	catch(std::exception & e)
+	{
+		logGlobal->error("Failed to make savegame snapshot: %s", e.what());
+		startJournal(EState::NONE);
+		return;
+	}
+
+	const auto current = snapshotPath;
+	lock.unlock();
+	removeUnusedSnapshots(fname.parent_path(), current);
+}
+
+void CGameStateSnapshots::removeUnusedSnapshots(const boost::filesystem::path & saveDirectory, const boost::filesystem::path & current)
+{
+	namespace bfs = boost::filesystem;
+	const auto snapshotsDirectory = getSnapshotsDirectory(saveDirectory);
+	const auto saveExtension = bfs::path(current.stem()).extension();
+
+	//savegames in subdirectories can refer to snapshots here
+	std::set<bfs::path> used = {normalizePath(current)};
+	boost::system::error_code ec;
+	for(bfs::recursive_directory_iterator it(saveDirectory, ec), end; it != end; it.increment(ec))
+	{
+		if(it->path().extension() != saveExtension)
+			continue;
+		const auto snapshotName = getSnapshotName(it->path());
+		if(!snapshotName.empty())
+			used.insert(normalizePath(getSnapshotPath(it->path().parent_path(), snapshotName)));
+	}
+
+	for(bfs::directory_iterator it(snapshotsDirectory, ec), end; it != end; it.increment(ec))
+	{
+		const auto & path = it->path();
+		if(path.extension() == SNAPSHOT_EXTENSION && bfs::path(path.stem()).extension() == saveExtension
+			&& !vstd::contains(used, normalizePath(path)))
+		{
+			logGlobal->debug("Removing unused savegame snapshot %s", path.string());
+			bfs::remove(path, ec);
+		}
+	}
+}
+
+void CGameStateSnapshots::loadDelta(BinaryDeserializer & in, const boost::filesystem::path & snapshot)
+{
+	std::vector<ui8> loadedJournal;
+	ui32 loadedPacksCount;
+	in & loadedJournal & loadedPacksCount;
+
+	boost::unique_lock<boost::mutex> lock(mx);
+	startJournal(EState::NONE);
+	journal = std::move(loadedJournal);
+	addStdVecItems(gs);
+	sendStackInstanceByIds = true;
+	iser.fileVersion = in.fileVersion;
+	iser.reverseEndianess = in.reverseEndianess;
+	lock.unlock();
+
+	logGlobal->info("\tReplaying %d changes since snapshot %s", loadedPacksCount, snapshot.filename().string());
+	for(ui32 i = 0; i < loadedPacksCount; i++)
+	{
+		CPack * pack = nullptr;
+		iser & pack;
+		if(iser.fileVersion >= FIRST_PACK_GENERATOR_VERSION)
+		{
+			bool generatorChanged;
+			iser & generatorChanged;
+			if(generatorChanged)
+				iser & gs->getRandomGenerator();
+		}
+		gs->apply(pack);
+		delete pack;
+	}
+	//generator is also used outside of packs
+	in & gs->getRandomGenerator();
+
+	lock.lock();
+	if(in.fileVersion < FIRST_PACK_GENERATOR_VERSION)
+	{
+		//packs recorded from now on could not be appended to the journal of older format
+		startJournal(EState::NONE);
+		return;
+	}
+	packsCount = loadedPacksCount;
+	snapshotPath = normalizePath(snapshot);
+	snapshotSize = boost::filesystem::file_size(snapshot);
+	state = EState::ACTIVE;
+}
+
+boost::filesystem::path CGameStateSnapshots::getSnapshotsDirectory(const boost::filesystem::path & saveDirectory)
+{
+	return saveDirectory / "Snapshots";
+}
+
+std::string CGameStateSnapshots::getSnapshotReference(const boost::filesystem::path & saveDirectory, const boost::filesystem::path & snapshot)
+{
+	const auto snapshotsDirectory = snapshot.parent_path();
+	const auto owner = snapshotsDirectory.parent_path();
+	auto it = saveDirectory.begin();
+	for(const auto & part : owner)
+	{
+		if(it == saveDirectory.end() || *it != part)
+			return "";
+		++it;
+	}
+
+	//snapshot in the same directory is referred to by its file name only, like by older versions
+	if(it == saveDirectory.end())
+		return snapshot.filename().string();
+
+	boost::filesystem::path ret;
+	for(; it != saveDirectory.end(); ++it)
+		ret /= "..";
+	return (ret / snapshotsDirectory.filename() / snapshot.filename()).generic_string();
+}
+
+boost::filesystem::path CGameStateSnapshots::getSnapshotPath(const boost::filesystem::path & saveDirectory, const std::string & snapshotName)
+{
+	const boost::filesystem::path reference(snapshotName);
+	if(reference.has_parent_path())
+		return normalizePath(saveDirectory / reference);
+	return getSnapshotsDirectory(saveDirectory) / snapshotName;
+}
+
+std::string CGameStateSnapshots::getSnapshotName(const boost::filesystem::path & fname)
+{
+	try
+	{
+		CLoadFile lf(fname, FIRST_DELTA_VERSION);
+		lf.checkMagicBytes(SAVEGAME_MAGIC);
+
+		CMapHeader header;
+		std::unique_ptr<StartInfo> si;
+		bool delta;
+		std::string snapshotName;
+		lf >> header >> si >> delta;
+		if(delta)
+			lf >> snapshotName;
+		return snapshotName;
+	}
+	catch(std::exception &)
+	{
+		return "";
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ * CGameStateSnapshots.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#pragma once
+
+#include "BinarySerializer.h"
+#include "BinaryDeserializer.h"
+#include "../CRandomGenerator.h"
+
+class CGameState;
+struct CPack;
+
+/// Makes savegames proportional to changes since the last full save.
+/// Every pack applied to the game state after a full save is recorded in the journal, serialized like for the network,
+/// together with the random generator state it was applied with, if that changed since the previous pack.
+/// Following savegames store only the journal and refer to a copy of that full save (snapshot), loading replays the journal on top of it.
+/// Full save (compaction) is made again when the journal grows as big as the snapshot.
+/// Snapshot is kept in Snapshots subdirectory of the full save, delta savegames in that directory and its subdirectories can refer to it.
+class DLL_LINKAGE CGameStateSnapshots
+	: public IBinaryReader, public IBinaryWriter
+{
+	enum class EState
+	{
+		NONE, //no usable snapshot, next save will be full
+		PENDING, //full save is being written, journal already records changes made after it
+		ACTIVE //snapshot is written, delta saves can be made
+	};
+
+	CGameState * gs;
+	boost::mutex mx;
+	EState state;
+	ui32 savesCount; //identifies savegames passed to saveFinished
+	ui32 pendingSave; //savegame which becomes the snapshot in PENDING state
+	std::vector<ui8> journal; //serialized packs applied since the snapshot
+	size_t readPos;
+	ui32 packsCount;
+	TGenerator journaledGenerator; //generator state of the last pack in the journal
+	bool generatorJournaled; //false if journaledGenerator is not in the journal yet
+	boost::filesystem::path snapshotPath;
+	ui64 snapshotSize;
+
+	BinarySerializer oser;
+	BinaryDeserializer iser;
+
+	int read(void * data, unsigned size) override;
+	int write(const void * data, unsigned size) override;
+
+	void startJournal(EState newState); //clears the journal and starts recording
+	void removeUnusedSnapshots(const boost::filesystem::path & saveDirectory, const boost::filesystem::path & current);
+	static boost::filesystem::path getSnapshotsDirectory(const boost::filesystem::path & saveDirectory);
+	/// Snapshot name written to delta savegame in saveDirectory, empty if snapshot is not in that directory or its parents
+	static std::string getSnapshotReference(const boost::filesystem::path & saveDirectory, const boost::filesystem::path & snapshot);
+public:
+	explicit CGameStateSnapshots(CGameState * GS);
+
+	void record(CPack * pack); //called before pack is applied on the game state
+
+	/// Writes delta flag and, if delta can be saved to out, the journal. Returns false if caller has to write the full state.
+	/// saveId identifies the savegame for saveFinished.
+	bool saveDelta(CSaveFile & out, ui32 & saveId);
+	/// Called after savegame file is closed. Copies full savegame as the new snapshot,
+	/// unless other full savegame was started after it, the journal is recorded since that one.
+	void saveFinished(const boost::filesystem::path & fname, ui32 saveId);
+
+	/// Reads the journal saved by saveDelta and replays it on the game state loaded from snapshot.
+	void loadDelta(BinaryDeserializer & in, const boost::filesystem::path & snapshot);
+
+	static boost::filesystem::path getSnapshotPath(const boost::filesystem::path & saveDirectory, const std::string & snapshotName); //snapshotName as returned by getSnapshotName
+	static std::string getSnapshotName(const boost::filesystem::path & fname); //empty if fname is a full savegame or can't be read
+};
@@ -40,7 +40,7 @@ int CLoadIntegrityValidator::read( void * data, unsigned size )
 		controlFile->read(controlData.data(), size);
 		if(std::memcmp(data, controlData.data(), size))
 		{
-			logGlobal->errorStream() << "Desync found! Position: " << primaryFile->sfile->tellg();
+			logGlobal->errorStream() << "Desync found! Position: " << primaryFile->tell();
 			foundDesync = true;
 			//throw std::runtime_error("Savegame dsynchronized!");
 		}
@@ -14,7 +14,7 @@
 #include "../ConstTransitivePtr.h"
 #include "../GameConstants.h"
 
-const ui32 SERIALIZATION_VERSION = 762;
+const ui32 SERIALIZATION_VERSION = 766;
 const ui32 MINIMAL_SERIALIZATION_VERSION = 753;
 const std::string SAVEGAME_MAGIC = "VCMISVG";
 
@@ -129,6 +129,29 @@ public:
 	void addStdVecItems(CGameState *gs, LibClasses *lib = VLC);
 };
 
+/// Types whose serialized form is their in-memory representation, so arrays of them can be written with a single call.
+/// TField is the fundamental type making up the whole object, used to fix byte order after bulk load.
+template<typename T, typename Enable = void>
+struct BulkSerializable
+{
+	static const bool value = false;
+};
+
+template<typename T>
+struct BulkSerializable<T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type>
+{
+	static const bool value = true;
+	typedef T TField;
+};
+
+class int3;
+template<>
+struct BulkSerializable<int3> //x, y, z
+{
+	static const bool value = true;
+	typedef si32 TField;
+};
+
 /// Helper to detect classes with user-provided serialize(S&, int version) method
 template<class S, class T>
 struct is_serializeable
@@ -190,6 +213,12 @@ struct VectorizedIDType
 class IBinaryReader : public virtual CSerializer
 {
 public:
+	/// Data readers holding it in memory let deserializer consume directly, read is called only once it's exhausted
+	const ui8 * window;
+	const ui8 * windowEnd;
+
+	IBinaryReader() : window(nullptr), windowEnd(nullptr) {}
+
 	virtual int read(void * data, unsigned size) = 0;
 };
 
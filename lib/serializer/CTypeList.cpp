@@ -17,11 +17,102 @@ extern template void registerTypes<CTypeList>(CTypeList & s);
 
 CTypeList typeList;
 
+const si32 CTypeList::CastTable::NO_RELATION;
+
 CTypeList::CTypeList()
+	: castTable(nullptr)
 {
 	registerTypes(*this);
 }
 
+ui16 CTypeList::CastTable::getTypeID(const std::type_info * type) const
+{
+	auto i = typeIDs.find(type);
+	if(i != typeIDs.end())
+		return i->second;
+
+	auto j = typeIDsByName.find(type);
+	if(j != typeIDsByName.end())
+		return j->second;
+
+	return 0;
+}
+
+const CTypeList::CastTable & CTypeList::getCastTable() const
+{
+	if(auto table = castTable.load(std::memory_order_acquire))
+		return *table;
+
+	TUniqueLock lock(mx);
+	if(auto table = castTable.load(std::memory_order_acquire))
+		return *table; //built by another thread meanwhile
+
+	auto table = make_unique<CastTable>();
+	table->size = typeInfos.size() + 1;
+	table->offsets.assign(table->size * table->size, CastTable::NO_RELATION);
+
+	std::vector<TypeInfoPtr> types(table->size);
+	for(auto & typeInfo : typeInfos)
+	{
+		table->typeIDs[typeInfo.first] = typeInfo.second->typeID;
+		table->typeIDsByName[typeInfo.first] = typeInfo.second->typeID;
+		types[typeInfo.second->typeID] = typeInfo.second;
+	}
+
+	//offsets to all bases of every type, summed along the shortest path like castSequence does
+	std::vector<si64> baseOffsets(table->size);
+	for(size_t derived = 1; derived < table->size; derived++)
+	{
+		std::fill(baseOffsets.begin(), baseOffsets.end(), CastTable::NO_RELATION);
+		baseOffsets[derived] = 0;
+		std::queue<TypeInfoPtr> q;
+		q.push(types[derived]);
+		while(!q.empty())
+		{
+			auto type = q.front();
+			q.pop();
+			for(size_t i = 0; i < type->parents.size(); i++)
+			{
+				auto parent = type->parents[i].lock();
+				if(baseOffsets[parent->typeID] == CastTable::NO_RELATION)
+				{
+					baseOffsets[parent->typeID] = baseOffsets[type->typeID] + type->parentOffsets[i];
+					q.push(parent);
+				}
+			}
+		}
+
+		for(size_t base = 1; base < table->size; base++)
+		{
+			if(baseOffsets[base] == CastTable::NO_RELATION)
+				continue;
+
+			table->offsets[derived * table->size + base] = baseOffsets[base];
+			table->offsets[base * table->size + derived] = -baseOffsets[base];
+		}
+	}
+
+	const CastTable * ret = table.get();
+	castTables.push_back(std::move(table));
+	castTable.store(ret, std::memory_order_release);
+	return *ret;
+}
+
+si32 CTypeList::getCastOffset(const std::type_info * from, const std::type_info * to) const
+{
+	const CastTable & table = getCastTable();
+	ui16 fromID = table.getTypeID(from);
+	ui16 toID = table.getTypeID(to);
+	if(!fromID || !toID)
+		THROW_FORMAT("Cannot find type descriptor for type %s. Was it registered?", (fromID ? to : from)->name());
+
+	si32 offset = table.offsets[fromID * table.size + toID];
+	if(offset == CastTable::NO_RELATION)
+		THROW_FORMAT("Cannot find relation between types %s and %s. Were they (and all classes between them) properly registered?", from->name() % to->name());
+
+	return offset;
+}
+
 CTypeList::TypeInfoPtr CTypeList::registerType(const std::type_info *type)
 {
 	if(auto typeDescr = getTypeDescriptor(type, false))
@@ -38,12 +129,18 @@ CTypeList::TypeInfoPtr CTypeList::registerType(const std::type_info *type)
 
 ui16 CTypeList::getTypeID(const std::type_info *type, bool throws) const
 {
-	auto descriptor = getTypeDescriptor(type, throws);
-	if (descriptor == nullptr)
+	if(auto table = castTable.load(std::memory_order_acquire))
 	{
-		return 0;
+		ui16 id = table->getTypeID(type);
+		if(!id && throws)
+			THROW_FORMAT("Cannot find type descriptor for type %s. Was it registered?", type->name());
+		return id;
 	}
-	return descriptor->typeID;
+
+	//table is rebuilt on first cast, appliers ask for ID of every type right after registering it
+	TSharedLock lock(mx);
+	auto descriptor = getTypeDescriptor(type, throws);
+	return descriptor ? descriptor->typeID : 0;
 }
 
 std::vector<CTypeList::TypeInfoPtr> CTypeList::castSequence(TypeInfoPtr from, TypeInfoPtr to) const
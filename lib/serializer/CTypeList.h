@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "CSerializer.h"
 
 struct IPointerCaster
@@ -72,6 +74,21 @@ class DLL_LINKAGE CTypeList: public boost::noncopyable
 		ui16 typeID;
 		const char *name;
 		std::vector<WeakTypeInfoPtr> children, parents;
+		std::vector<si32> parentOffsets; //address of parent subobject minus address of this type, same order as parents
+	};
+
+	/// Registered types with offsets between every pair of related types.
+	/// Rebuilt after registration of new types; readers don't lock.
+	struct CastTable
+	{
+		static const si32 NO_RELATION = std::numeric_limits<si32>::min();
+
+		std::unordered_map<const std::type_info *, ui16> typeIDs;
+		std::map<const std::type_info *, ui16, TypeComparer> typeIDsByName; //type_info objects may be not unique between libraries
+		size_t size; //number of type IDs, including 0
+		std::vector<si32> offsets; //[from * size + to], address of "to" object minus address of "from" object
+
+		ui16 getTypeID(const std::type_info * type) const;
 	};
 	typedef boost::shared_mutex TMutex;
 	typedef boost::unique_lock<TMutex> TUniqueLock;
@@ -79,6 +96,12 @@ class DLL_LINKAGE CTypeList: public boost::noncopyable
 private:
 	mutable TMutex mx;
 
+	mutable std::atomic<const CastTable *> castTable; //nullptr if types were registered since last build
+	mutable std::vector<std::unique_ptr<const CastTable>> castTables; //all built tables, readers may still use old ones
+
+	const CastTable & getCastTable() const;
+	si32 getCastOffset(const std::type_info * from, const std::type_info * to) const;
+
 	std::map<const std::type_info *, TypeInfoPtr, TypeComparer> typeInfos;
 	std::map<std::pair<TypeInfoPtr, TypeInfoPtr>, std::unique_ptr<const IPointerCaster>> casters; //for each pair <Base, Der> we provide a caster (each registered relations creates a single entry here)
 
@@ -118,6 +141,55 @@ private:
 	TypeInfoPtr getTypeDescriptor(const std::type_info *type, bool throws = true) const; //if not throws, failure returns nullptr
 	TypeInfoPtr registerType(const std::type_info *type);
 
+public:
+	/// Dynamic type of object seen through pointer to one of its bases
+	struct DynamicTypeInfo
+	{
+		const std::type_info * type;
+		ui16 typeID; //0 if type is not registered
+		std::ptrdiff_t offset; //from base subobject to the most derived object
+	};
+
+private:
+	/// Dynamic types met for pointers of static type T. Lists are replaced, never modified, so readers need no lock.
+	template<typename T>
+	struct DynamicTypeCache
+	{
+		static std::atomic<const std::vector<DynamicTypeInfo> *> entries;
+	};
+
+	mutable boost::mutex cacheMx;
+	mutable std::vector<std::unique_ptr<const std::vector<DynamicTypeInfo>>> cacheStorage; //all lists ever published, may still be in use
+
+	template<typename T>
+	const DynamicTypeInfo * findCached(const std::type_info * type) const
+	{
+		auto cached = DynamicTypeCache<T>::entries.load(std::memory_order_acquire);
+		if(cached)
+		{
+			for(auto & entry : *cached)
+			{
+				if(entry.type == type || !strcmp(entry.type->name(), type->name()))
+					return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	template<typename T>
+	const DynamicTypeInfo & addCached(const DynamicTypeInfo & info) const
+	{
+		boost::unique_lock<boost::mutex> lock(cacheMx);
+		auto old = DynamicTypeCache<T>::entries.load(std::memory_order_acquire);
+		auto updated = old ? make_unique<std::vector<DynamicTypeInfo>>(*old) : make_unique<std::vector<DynamicTypeInfo>>();
+		updated->push_back(info);
+
+		const std::vector<DynamicTypeInfo> * ret = updated.get();
+		cacheStorage.push_back(std::move(updated));
+		DynamicTypeCache<T>::entries.store(ret, std::memory_order_release);
+		return ret->back();
+	}
+
 public:
 
 	CTypeList();
@@ -134,11 +206,21 @@ public:
 		auto bti = registerType(bt);
 		auto dti = registerType(dt); //obtain our TypeDescriptor
 
+		//every serializer registers all types again
+		if(casters.count(std::make_pair(bti, dti)))
+			return;
+
+		//base subobject is at constant offset, inheritance is never virtual (casters use static_cast)
+		const uintptr_t someAddress = 0x10000;
+		auto base = static_cast<Base *>(reinterpret_cast<Derived *>(someAddress));
+
 		// register the relation between classes
 		bti->children.push_back(dti);
 		dti->parents.push_back(bti);
+		dti->parentOffsets.push_back(static_cast<si32>(reinterpret_cast<uintptr_t>(base) - someAddress));
 		casters[std::make_pair(bti, dti)] = make_unique<const PointerCaster<Base, Derived>>();
 		casters[std::make_pair(dti, bti)] = make_unique<const PointerCaster<Derived, Base>>();
+		castTable.store(nullptr, std::memory_order_release);
 	}
 
 	ui16 getTypeID(const std::type_info *type, bool throws = false) const;
@@ -155,14 +237,7 @@ public:
 		auto &baseType = typeid(typename std::remove_cv<TInput>::type);
 		auto derivedType = getTypeInfo(inputPtr);
 
-		if (strcmp(baseType.name(), derivedType->name()) == 0)
-		{
-			return const_cast<void*>(reinterpret_cast<const void*>(inputPtr));
-		}
-
-		return boost::any_cast<void*>(castHelper<&IPointerCaster::castRawPtr>(
-			const_cast<void*>(reinterpret_cast<const void*>(inputPtr)), &baseType,
-			derivedType));
+		return castRaw(const_cast<void*>(reinterpret_cast<const void*>(inputPtr)), &baseType, derivedType);
 	}
 
 	template<typename TInput>
@@ -177,9 +252,47 @@ public:
 		return castHelper<&IPointerCaster::castSharedPtr>(inputPtr, &baseType, derivedType);
 	}
 
+	/// Type ID and offset to the most derived object, computed once per static and dynamic type
+	template<typename TInput>
+	const DynamicTypeInfo & getDynamicTypeInfo(const TInput * inputPtr) const
+	{
+		typedef typename std::remove_cv<TInput>::type T;
+		auto type = getTypeInfo(inputPtr);
+		if(auto cached = findCached<T>(type))
+			return *cached;
+
+		DynamicTypeInfo info;
+		info.type = type;
+		info.typeID = getTypeID(type);
+		info.offset = 0; //unregistered types are serialized through static type
+		if(info.typeID)
+			info.offset = static_cast<const char *>(castToMostDerived(inputPtr)) - reinterpret_cast<const char *>(inputPtr);
+		return addCached<T>(info);
+	}
+
+	/// Same as castRaw from the most derived type, but the cast is computed once per pair of types
+	template<typename T>
+	T * castFromMostDerived(void * inputPtr, const std::type_info * from) const
+	{
+		typedef typename std::remove_cv<T>::type TBase;
+		auto cached = findCached<TBase>(from);
+		if(!cached)
+		{
+			DynamicTypeInfo info;
+			info.type = from;
+			info.typeID = getTypeID(from);
+			info.offset = static_cast<char *>(inputPtr) - static_cast<char *>(castRaw(inputPtr, from, &typeid(TBase)));
+			cached = &addCached<TBase>(info);
+		}
+		return reinterpret_cast<T *>(static_cast<char *>(inputPtr) - cached->offset);
+	}
+
 	void * castRaw(void *inputPtr, const std::type_info *from, const std::type_info *to) const
 	{
-		return boost::any_cast<void*>(castHelper<&IPointerCaster::castRawPtr>(inputPtr, from, to));
+		if(!inputPtr || from == to || !strcmp(from->name(), to->name()))
+			return inputPtr;
+
+		return static_cast<char *>(inputPtr) + getCastOffset(from, to);
 	}
 	boost::any castShared(boost::any inputPtr, const std::type_info *from, const std::type_info *to) const
 	{
@@ -195,6 +308,9 @@ public:
 	}
 };
 
+template<typename T>
+std::atomic<const std::vector<CTypeList::DynamicTypeInfo> *> CTypeList::DynamicTypeCache<T>::entries(nullptr);
+
 extern DLL_LINKAGE CTypeList typeList;
 
 /// Wrapper over CTypeList. Allows execution of templated class T for any type
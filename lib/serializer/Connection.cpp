@@ -4,8 +4,10 @@
 #include "../registerTypes/RegisterTypes.h"
 #include "../mapping/CMap.h"
 #include "../CGameState.h"
+#include "../CThreadHelper.h"
 
 #include <boost/asio.hpp>
+#include <zlib.h>
 
 /*
  * Connection.cpp, part of VCMI engine
@@ -30,6 +32,104 @@ using namespace boost::asio::ip;
 #define LIL_ENDIAN
 #endif
 
+static const ui32 MAX_FRAME_SIZE = 64 << 20; //bigger frames are rejected, before and after decompression
+static const size_t RECEIVE_CHUNK_SIZE = 1 << 20; //frame buffers grow as data arrives, so declared size alone doesn't allocate
+static const size_t MAX_FRAMES_PER_WRITE = 64;
+static const int SEND_QUEUE_STOP_TIMEOUT_MS = 5000; //how long stopping queue waits for remaining frames to be sent to peer that doesn't read
+static const size_t COMPRESSION_THRESHOLD = 4096; //smaller frames are sent as they are
+
+/// First byte of every frame
+namespace EFrameCodec
+{
+	enum EFrameCodec : ui8
+	{
+		RAW,
+		ZLIB //followed by size of data before compression
+	};
+}
+
+static ui32 reverseBytes(ui32 value)
+{
+	return ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+}
+
+/// Fills codec of frame that was serialized after one reserved byte, big frames are compressed
+static TFrame packFrame(std::vector<ui8> && data, bool allowCompression)
+{
+	if(data.size() > MAX_FRAME_SIZE)
+		throw std::runtime_error("Frame of size " + boost::lexical_cast<std::string>(data.size()) + " is too big to be sent");
+
+	data[0] = EFrameCodec::RAW;
+	if(allowCompression && data.size() > COMPRESSION_THRESHOLD)
+	{
+		ui32 rawSize = data.size() - 1;
+		std::vector<ui8> packed(1 + sizeof(rawSize) + compressBound(rawSize));
+		uLongf packedSize = packed.size() - 1 - sizeof(rawSize);
+		if(compress2(packed.data() + 1 + sizeof(rawSize), &packedSize, data.data() + 1, rawSize, Z_BEST_SPEED) == Z_OK && packedSize < rawSize)
+		{
+			packed[0] = EFrameCodec::ZLIB;
+			std::memcpy(packed.data() + 1, &rawSize, sizeof(rawSize)); //in our byte order, like frame length
+			packed.resize(1 + sizeof(rawSize) + packedSize);
+			return std::make_shared<const std::vector<ui8>>(std::move(packed));
+		}
+	}
+	return std::make_shared<const std::vector<ui8>>(std::move(data));
+}
+
+/// Decompresses frame received with ZLIB codec. Output grows as it is produced, up to the declared size.
+static std::vector<ui8> inflateFrame(const std::vector<ui8> & frame, ui32 rawSize)
+{
+	const size_t headerSize = 1 + sizeof(rawSize);
+	z_stream stream = {};
+	if(inflateInit(&stream) != Z_OK)
+		throw std::runtime_error("Failed to decompress received frame");
+
+	stream.next_in = const_cast<Bytef *>(frame.data() + headerSize);
+	stream.avail_in = frame.size() - headerSize;
+
+	std::vector<ui8> raw(1, EFrameCodec::RAW);
+	int ret = Z_OK;
+	while(ret == Z_OK && raw.size() < rawSize + 1)
+	{
+		const size_t offset = raw.size();
+		const size_t chunk = std::min<size_t>(rawSize + 1 - offset, RECEIVE_CHUNK_SIZE);
+		raw.resize(offset + chunk);
+		stream.next_out = raw.data() + offset;
+		stream.avail_out = chunk;
+		ret = inflate(&stream, Z_NO_FLUSH);
+		raw.resize(offset + chunk - stream.avail_out);
+	}
+	if(ret == Z_OK) //output is full, stream has to end here
+	{
+		stream.next_out = raw.data() + raw.size();
+		stream.avail_out = 0;
+		ret = inflate(&stream, Z_FINISH);
+	}
+	inflateEnd(&stream);
+
+	if(ret != Z_STREAM_END || raw.size() != rawSize + 1)
+		throw std::runtime_error("Failed to decompress received frame");
+	return raw;
+}
+
+struct CConnection::SendQueue
+{
+	boost::mutex mx;
+	boost::condition_variable cond;
+	std::deque<TFrame> frames;
+	SendQueueStats stats;
+
+	size_t maxQueuedBytes;
+	ESlowPeerPolicy policy;
+	bool stopping; //writer sends remaining frames and ends
+	bool failed; //peer is gone, frames are discarded and writer shuts the socket down
+	boost::thread writer;
+
+	SendQueue(size_t MaxQueuedBytes, ESlowPeerPolicy Policy)
+		: maxQueuedBytes(MaxQueuedBytes), policy(Policy), stopping(false), failed(false)
+	{}
+};
+
 
 void CConnection::init()
 {
@@ -46,6 +146,8 @@ void CConnection::init()
 	myEndianess = false;
 #endif
 	connected = true;
+	framed = false;
+	readPos = 0;
 	std::string pom;
 	//we got connection
 	oser & std::string("Aiya!\n") & name & myEndianess; //identify ourselves
@@ -59,6 +161,7 @@ void CConnection::init()
 	static int cid = 1;
 	connectionID = cid++;
 	iser.fileVersion = SERIALIZATION_VERSION;
+	framed = true;
 }
 
 CConnection::CConnection(std::string host, std::string port, std::string Name)
@@ -136,12 +239,46 @@ CConnection::CConnection(TAcceptor * acceptor, boost::asio::io_service *Io_servi
 	init();
 }
 int CConnection::write(const void * data, unsigned size)
+{
+	if(framed)
+	{
+		if(writeBuffer.empty())
+			writeBuffer.push_back(EFrameCodec::RAW); //reserved for codec of the frame
+		auto bytes = static_cast<const ui8 *>(data);
+		writeBuffer.insert(writeBuffer.end(), bytes, bytes + size);
+	}
+	else
+		writeToSocket({asio::const_buffer(data, size)});
+	return size;
+}
+int CConnection::read(void * data, unsigned size)
+{
+	if(!framed)
+	{
+		readFromSocket(data, size);
+		return size;
+	}
+
+	//serialized object may span several frames
+	auto bytes = static_cast<ui8 *>(data);
+	unsigned done = 0;
+	while(done < size)
+	{
+		if(readPos == readBuffer.size())
+			receiveFrame();
+
+		unsigned toCopy = std::min<size_t>(size - done, readBuffer.size() - readPos);
+		std::copy_n(readBuffer.data() + readPos, toCopy, bytes + done);
+		readPos += toCopy;
+		done += toCopy;
+	}
+	return size;
+}
+void CConnection::writeToSocket(const std::vector<asio::const_buffer> & buffers)
 {
 	try
 	{
-		int ret;
-		ret = asio::write(*socket,asio::const_buffers_1(asio::const_buffer(data,size)));
-		return ret;
+		asio::write(*socket, buffers);
 	}
 	catch(...)
 	{
@@ -150,12 +287,11 @@ int CConnection::write(const void * data, unsigned size)
 		throw;
 	}
 }
-int CConnection::read(void * data, unsigned size)
+void CConnection::readFromSocket(void * data, unsigned size)
 {
 	try
 	{
-		int ret = asio::read(*socket,asio::mutable_buffers_1(asio::mutable_buffer(data,size)));
-		return ret;
+		asio::read(*socket,asio::mutable_buffers_1(asio::mutable_buffer(data,size)));
 	}
 	catch(...)
 	{
@@ -164,8 +300,213 @@ int CConnection::read(void * data, unsigned size)
 		throw;
 	}
 }
+void CConnection::receiveFrame()
+{
+	ui32 length;
+	readFromSocket(&length, sizeof(length));
+	if(myEndianess != contactEndianess)
+		length = reverseBytes(length);
+
+	if(length == 0 || length > MAX_FRAME_SIZE)
+	{
+		connected = false;
+		throw std::runtime_error("Received frame of invalid size " + boost::lexical_cast<std::string>(length));
+	}
+
+	readBuffer.clear();
+	while(readBuffer.size() < length)
+	{
+		const size_t offset = readBuffer.size();
+		const size_t chunk = std::min<size_t>(length - offset, RECEIVE_CHUNK_SIZE);
+		readBuffer.resize(offset + chunk);
+		readFromSocket(readBuffer.data() + offset, chunk);
+	}
+	readPos = 1; //skip codec
+
+	if(readBuffer[0] == EFrameCodec::ZLIB)
+	{
+		ui32 rawSize;
+		if(length < 1 + sizeof(rawSize))
+			throw std::runtime_error("Received truncated compressed frame");
+		std::memcpy(&rawSize, readBuffer.data() + 1, sizeof(rawSize));
+		if(myEndianess != contactEndianess)
+			rawSize = reverseBytes(rawSize);
+		if(rawSize > MAX_FRAME_SIZE)
+			throw std::runtime_error("Received compressed frame of invalid size " + boost::lexical_cast<std::string>(rawSize));
+
+		auto raw = inflateFrame(readBuffer, rawSize);
+		readBuffer.swap(raw);
+	}
+	else if(readBuffer[0] != EFrameCodec::RAW)
+		throw std::runtime_error("Received frame with unknown codec");
+}
+void CConnection::flush()
+{
+	if(writeBuffer.empty())
+		return;
+
+	writeFrame(packFrame(std::move(writeBuffer), true));
+	writeBuffer.clear();
+}
+void CConnection::sendFrame(TFrame frame)
+{
+	assert(framed);
+	flush();
+	writeFrame(frame);
+}
+void CConnection::writeFrame(TFrame frame)
+{
+	if(!sendQueue)
+	{
+		//length is sent in our byte order, receiver knows it from handshake
+		ui32 length = frame->size();
+		writeToSocket({asio::const_buffer(&length, sizeof(length)), asio::const_buffer(frame->data(), frame->size())});
+		return;
+	}
+
+	SendQueue & queue = *sendQueue;
+	boost::unique_lock<boost::mutex> lock(queue.mx);
+	if(!queue.failed && queue.stats.queuedBytes + frame->size() > queue.maxQueuedBytes && !queue.frames.empty())
+	{
+		queue.stats.stalls++;
+		if(queue.policy == ESlowPeerPolicy::WAIT)
+		{
+			queue.cond.wait(lock, [&]()
+			{
+				return queue.failed || queue.stats.queuedBytes + frame->size() <= queue.maxQueuedBytes || queue.frames.empty();
+			});
+		}
+		else
+		{
+			logNetwork->warnStream() << *this << " has " << queue.stats.queuedBytes << " bytes waiting to be sent, disconnecting";
+			queue.failed = true;
+			connected = false;
+			for(auto & waiting : queue.frames)
+				queue.stats.queuedBytes -= waiting->size();
+			queue.stats.queuedFrames -= queue.frames.size();
+			queue.frames.clear();
+			queue.cond.notify_all(); //socket is shut down by writer, it may be in the middle of a write now
+		}
+	}
+
+	if(queue.failed)
+		return; //peer is gone, reading thread handles that
+
+	queue.frames.push_back(frame);
+	queue.stats.queuedFrames++;
+	queue.stats.queuedBytes += frame->size();
+	vstd::amax(queue.stats.peakQueuedBytes, queue.stats.queuedBytes);
+	queue.cond.notify_all();
+}
+void CConnection::enableSendQueue(size_t maxQueuedBytes, ESlowPeerPolicy policy)
+{
+	assert(framed);
+	stopSendQueue(); //connection may be reused for next game
+	sendQueue = make_unique<SendQueue>(maxQueuedBytes, policy);
+	sendQueue->writer = boost::thread(&CConnection::writerLoop, this);
+}
+SendQueueStats CConnection::getSendQueueStats() const
+{
+	if(!sendQueue)
+		return SendQueueStats();
+
+	boost::unique_lock<boost::mutex> lock(sendQueue->mx);
+	return sendQueue->stats;
+}
+void CConnection::writerLoop()
+{
+	setThreadName("CConnection::writerLoop");
+	SendQueue & queue = *sendQueue;
+	std::vector<TFrame> frames;
+	std::vector<ui32> lengths;
+	std::vector<asio::const_buffer> buffers;
+	while(true)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(queue.mx);
+			queue.cond.wait(lock, [&](){ return queue.failed || queue.stopping || !queue.frames.empty(); });
+			if(queue.failed)
+			{
+				boost::system::error_code ec;
+				socket->shutdown(tcp::socket::shutdown_both, ec); //wakes up reading thread that handles the disconnection
+				return;
+			}
+			if(queue.frames.empty())
+				return;
+
+			//everything that is waiting goes out with one write
+			while(!queue.frames.empty() && frames.size() < MAX_FRAMES_PER_WRITE)
+			{
+				frames.push_back(queue.frames.front());
+				queue.frames.pop_front();
+			}
+		}
+
+		size_t bytes = 0;
+		lengths.resize(frames.size());
+		for(size_t i = 0; i < frames.size(); i++)
+		{
+			lengths[i] = frames[i]->size();
+			bytes += lengths[i];
+			buffers.push_back(asio::const_buffer(&lengths[i], sizeof(ui32)));
+			buffers.push_back(asio::const_buffer(frames[i]->data(), frames[i]->size()));
+		}
+
+		bool ok = true;
+		try
+		{
+			writeToSocket(buffers);
+		}
+		catch(std::exception & e)
+		{
+			logNetwork->errorStream() << *this << " failed to send data: " << e.what();
+			ok = false;
+		}
+
+		boost::unique_lock<boost::mutex> lock(queue.mx);
+		queue.stats.queuedFrames -= frames.size();
+		queue.stats.queuedBytes -= bytes;
+		queue.stats.sentFrames += frames.size();
+		queue.stats.sentBytes += bytes;
+		if(!ok)
+		{
+			queue.failed = true;
+			queue.frames.clear();
+			queue.stats.queuedFrames = queue.stats.queuedBytes = 0;
+		}
+		queue.cond.notify_all();
+		frames.clear();
+		buffers.clear();
+	}
+}
+void CConnection::stopSendQueue()
+{
+	if(!sendQueue)
+		return;
+
+	{
+		boost::unique_lock<boost::mutex> lock(sendQueue->mx);
+		sendQueue->stopping = true;
+		sendQueue->cond.notify_all();
+	}
+	if(!sendQueue->writer.timed_join(boost::posix_time::milliseconds(SEND_QUEUE_STOP_TIMEOUT_MS)))
+	{
+		//writer is stuck in write to peer that doesn't read, shutting the socket down makes the write fail
+		logNetwork->warnStream() << *this << " didn't receive remaining data in time, disconnecting";
+		boost::system::error_code ec;
+		socket->shutdown(tcp::socket::shutdown_both, ec);
+		sendQueue->writer.join();
+	}
+
+	auto stats = sendQueue->stats;
+	logNetwork->debugStream() << *this << " sent " << stats.sentFrames << " frames (" << stats.sentBytes << " bytes), at most "
+		<< stats.peakQueuedBytes << " bytes were queued, sender waited " << stats.stalls << " times";
+	sendQueue.reset();
+}
 CConnection::~CConnection(void)
 {
+	stopSendQueue();
+
 	if(handler)
 		handler->join();
 
@@ -188,6 +529,7 @@ CConnection & CConnection::operator&(const T &t) {
 
 void CConnection::close()
 {
+	stopSendQueue();
 	if(socket)
 	{
 		socket->close();
@@ -216,6 +558,8 @@ CPack * CConnection::retreivePack()
 	CPack *ret = nullptr;
 	boost::unique_lock<boost::mutex> lock(*rmx);
 	logNetwork->traceStream() << "Listening... ";
+	if(framed && readPos == readBuffer.size())
+		receiveFrame(); //pack is deserialized from memory once its frame has arrived
 	iser & ret;
 	logNetwork->traceStream() << "\treceived server message of type " << (ret? typeid(*ret).name() : "nullptr") << ", data: " << ret;
 	return ret;
@@ -226,6 +570,7 @@ void CConnection::sendPackToServer(const CPack &pack, PlayerColor player, ui32 r
 	boost::unique_lock<boost::mutex> lock(*wmx);
 	logNetwork->traceStream() << "Sending to server a pack of type " << typeid(pack).name();
 	oser & player & requestID & &pack; //packs has to be sent as polymorphic pointers!
+	flush();
 }
 
 void CConnection::disableStackSendingByID()
@@ -251,6 +596,7 @@ void CConnection::enableSmartPointerSerialization()
 void CConnection::prepareForSendingHeroes()
 {
 	iser.loadedPointers.clear();
+	iser.loadedPointersTypes.clear();
 	oser.savedPointers.clear();
 	disableSmartVectorMemberSerialization();
 	enableSmartPointerSerialization();
@@ -260,6 +606,7 @@ void CConnection::prepareForSendingHeroes()
 void CConnection::enterPregameConnectionMode()
 {
 	iser.loadedPointers.clear();
+	iser.loadedPointersTypes.clear();
 	oser.savedPointers.clear();
 	disableSmartVectorMemberSerialization();
 	disableSmartPointerSerialization();
@@ -275,6 +622,39 @@ void CConnection::enableSmartVectorMemberSerializatoin()
 	CSerializer::smartVectorMembersSerialization = true;
 }
 
+CFrameSerializer::CFrameSerializer()
+	: compressFrames(true), oser(this)
+{
+	registerTypes(oser);
+	oser.smartPointerSerialization = false;
+}
+
+int CFrameSerializer::write(const void * data, unsigned size)
+{
+	if(buffer.empty())
+		buffer.push_back(EFrameCodec::RAW);
+	auto bytes = static_cast<const ui8 *>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+	return size;
+}
+
+TFrame CFrameSerializer::takeFrame()
+{
+	if(buffer.empty())
+		buffer.push_back(EFrameCodec::RAW);
+	auto ret = packFrame(std::move(buffer), compressFrames);
+	buffer.clear();
+	return ret;
+}
+
+bool CFrameSerializer::canSendTo(const CConnection & c) const
+{
+	//vectorized types are registered from the same game state on every connection
+	return c.framed && !c.oser.smartPointerSerialization
+		&& c.sendStackInstanceByIds == sendStackInstanceByIds
+		&& c.smartVectorMembersSerialization == smartVectorMembersSerialization;
+}
+
 std::ostream & operator<<(std::ostream &str, const CConnection &cpc)
  {
 	return str << "Connection with " << cpc.name << " (ID: " << cpc.connectionID << /*", " << (cpc.host ? "host" : "guest") <<*/ ")";
@@ -25,6 +25,7 @@ namespace boost
 			class tcp;
 		}
 		class io_service;
+		class const_buffer;
 
 		template <typename Protocol> class stream_socket_service;
 		template <typename Protocol,typename StreamSocketService>
@@ -40,19 +41,55 @@ namespace boost
 typedef boost::asio::basic_stream_socket < boost::asio::ip::tcp , boost::asio::stream_socket_service<boost::asio::ip::tcp>  > TSocket;
 typedef boost::asio::basic_socket_acceptor<boost::asio::ip::tcp, boost::asio::socket_acceptor_service<boost::asio::ip::tcp> > TAcceptor;
 
+typedef std::shared_ptr<const std::vector<ui8>> TFrame; //serialized data shared between connections
+
+/// Counters of connection send queue, tell how much peer falls behind
+struct SendQueueStats
+{
+	size_t queuedFrames, queuedBytes; //currently waiting to be sent
+	size_t peakQueuedBytes;
+	ui64 sentFrames, sentBytes;
+	ui32 stalls; //times sender had to wait for queue to shrink
+
+	SendQueueStats()
+		: queuedFrames(0), queuedBytes(0), peakQueuedBytes(0), sentFrames(0), sentBytes(0), stalls(0)
+	{}
+};
+
 /// Main class for network communication
 /// Allows establishing connection and bidirectional read-write
 class DLL_LINKAGE CConnection
 	: public IBinaryReader, public IBinaryWriter
 {
+	struct SendQueue;
+
 	CConnection(void);
 
+	std::unique_ptr<SendQueue> sendQueue; //if set, frames are written by separate thread
+
+	std::vector<ui8> writeBuffer; //data of the frame being serialized
+	std::vector<ui8> readBuffer; //last received frame
+	size_t readPos; //index of the next byte to be read from readBuffer
+
 	void init();
 	void reportState(CLogger * out) override;
 
 	int write(const void * data, unsigned size) override;
 	int read(void * data, unsigned size) override;
+
+	void writeToSocket(const std::vector<boost::asio::const_buffer> & buffers);
+	void readFromSocket(void * data, unsigned size);
+	void receiveFrame(); //reads whole next frame into readBuffer
+	void writeFrame(TFrame frame);
+	void writerLoop();
+	void stopSendQueue();
 public:
+	enum class ESlowPeerPolicy
+	{
+		WAIT, //sender waits until peer receives enough data
+		DISCONNECT //connection is closed, peer can't catch up with skipped data anyway
+	};
+
 	BinaryDeserializer iser;
 	BinarySerializer oser;
 
@@ -67,6 +104,7 @@ public:
 	boost::thread *handler;
 
 	bool receivedStop, sendStop;
+	bool framed; //after handshake data is sent in frames prefixed with their length, each frame with a single socket write
 
 	CConnection(std::string host, std::string port, std::string Name);
 	CConnection(TAcceptor * acceptor, boost::asio::io_service *Io_service, std::string Name);
@@ -80,6 +118,13 @@ public:
 
 	CPack *retreivePack(); //gets from server next pack (allocates it with new)
 	void sendPackToServer(const CPack &pack, PlayerColor player, ui32 requestID);
+	void flush(); //sends buffered data as one frame, has to be called with wmx locked
+	void sendFrame(TFrame frame); //sends data serialized by CFrameSerializer, has to be called with wmx locked
+
+	/// Sending thread only puts frames to a queue written to the socket by a separate thread.
+	/// When more than maxQueuedBytes are waiting, policy decides what to do with the peer.
+	void enableSendQueue(size_t maxQueuedBytes, ESlowPeerPolicy policy);
+	SendQueueStats getSendQueueStats() const;
 
 	void disableStackSendingByID();
 	void enableStackSendingByID();
@@ -102,8 +147,34 @@ public:
 	CConnection & operator<<(const T &t)
 	{
 		oser & t;
+		flush();
 		return * this;
 	}
 };
 
+/// Serializes objects into frames that can be sent to many connections.
+/// Pointers are always sent by value, so the result does not depend on the pointers already sent through a connection.
+class DLL_LINKAGE CFrameSerializer
+	: public IBinaryWriter
+{
+	std::vector<ui8> buffer;
+
+	int write(const void * data, unsigned size) override;
+public:
+	bool compressFrames; //frames bigger than few kB are compressed
+	BinarySerializer oser;
+
+	CFrameSerializer();
+
+	bool canSendTo(const CConnection & c) const; //true if c would serialize objects to the same bytes
+
+	template<class T>
+	TFrame serialize(const T &t)
+	{
+		oser & t;
+		return takeFrame();
+	}
+	TFrame takeFrame(); //returns everything serialized since last call as one frame
+};
+
 DLL_LINKAGE std::ostream &operator<<(std::ostream &str, const CConnection &cpc);
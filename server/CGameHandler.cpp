@@ -28,6 +28,7 @@
 #include "CVCMIServer.h"
 #include "../lib/CCreatureSet.h"
 #include "../lib/CThreadHelper.h"
+#include "../lib/CConfigHandler.h"
 #include "../lib/GameConstants.h"
 #include "../lib/registerTypes/RegisterTypes.h"
 #include "../lib/serializer/CTypeList.h"
@@ -1428,6 +1429,7 @@ CGameHandler::CGameHandler(void)
 
 CGameHandler::~CGameHandler(void)
 {
+	CBackgroundSaveWriter::get().waitForAll(); //savegames being written refer to game state
 	delete spellEnv;
 	delete applier;
 	applier = nullptr;
@@ -1858,6 +1860,11 @@ void CGameHandler::run(bool resume)
 		cc->addStdVecItems(gs);
 		cc->enableStackSendingByID();
 		cc->disableSmartPointerSerialization();
+
+		//game logic shouldn't wait for slow clients
+		const JsonNode & config = settings["server"];
+		auto policy = config["slowClientPolicy"].String() == "disconnect" ? CConnection::ESlowPeerPolicy::DISCONNECT : CConnection::ESlowPeerPolicy::WAIT;
+		cc->enableSendQueue(config["sendQueueLimit"].Float(), policy);
 	}
 
 	for (auto & elem : conns)
@@ -1929,6 +1936,10 @@ void CGameHandler::run(bool resume)
 					{
 						static time_duration p = milliseconds(100);
 						states.cv.timed_wait(lock, p);
+
+						lock.unlock(); //packs are sent under gsm, which is locked before states.mx elsewhere
+						reportFinishedSaves();
+						lock.lock();
 					}
 				}
 			}
@@ -2628,10 +2639,26 @@ void CGameHandler::heroExchange(ObjectInstanceID hero1, ObjectInstanceID hero2)
 void CGameHandler::sendToAllClients(CPackForClient * info)
 {
 	logNetwork->trace("Sending to all clients a package of type %s", typeid(*info).name());
+	boost::unique_lock<boost::mutex> broadcastLock(broadcastMx);
+	if(!broadcastSerializer)
+	{
+		broadcastSerializer = make_unique<CFrameSerializer>();
+		broadcastSerializer->addStdVecItems(gs);
+		broadcastSerializer->sendStackInstanceByIds = true;
+	}
+
+	TFrame frame;
 	for (auto & elem : conns)
 	{
 		boost::unique_lock<boost::mutex> lock(*(elem)->wmx);
-		*elem << info;
+		if(broadcastSerializer->canSendTo(*elem))
+		{
+			if(!frame)
+				frame = broadcastSerializer->serialize(info);
+			elem->sendFrame(frame);
+		}
+		else
+			*elem << info; //connection is in a special mode (e.g. sends heroes between campaign scenarios)
 	}
 }
 
@@ -2680,13 +2707,25 @@ void CGameHandler::save(const std::string & filename)
 
 	try
 	{
+		const auto savePath = *CResourceHandler::get("local")->getResourceName(ResourceID(stem.to_string(), EResType::SERVER_SAVEGAME));
+		CSaveFile save(savePath, true, true);
+		const ui32 saveId = saveCommonState(save);
+		logGlobal->info("Saving server state");
+		save << *this;
+
+		//state is serialized in memory, game goes on while it's compressed and written
+		save.close([this, savePath, stem, saveId](bool success)
 		{
-			CSaveFile save(*CResourceHandler::get("local")->getResourceName(ResourceID(stem.to_string(), EResType::SERVER_SAVEGAME)));
-			saveCommonState(save);
-			logGlobal->info("Saving server state");
-			save << *this;
-		}
-		logGlobal->info("Game has been successfully saved!");
+			if(success)
+			{
+				saveFinished(savePath, saveId);
+				logGlobal->info("Game has been successfully saved!");
+			}
+
+			//writer thread can't touch the game, result is sent to players by reportFinishedSaves
+			boost::unique_lock<boost::mutex> lock(finishedSavesMx);
+			finishedSaves.push_back(FinishedSave{stem.to_string(), success});
+		});
 	}
 	catch(std::exception &e)
 	{
@@ -2694,6 +2733,22 @@ void CGameHandler::save(const std::string & filename)
 	}
 }
 
+void CGameHandler::reportFinishedSaves()
+{
+	std::vector<FinishedSave> saves;
+	{
+		boost::unique_lock<boost::mutex> lock(finishedSavesMx);
+		saves.swap(finishedSaves);
+	}
+	if(saves.empty() || end2)
+		return;
+
+	boost::unique_lock<boost::recursive_mutex> lock(gsm);
+	const JsonNode & texts = VLC->generaltexth->localizedTexts["savegame"];
+	for(auto & save : saves)
+		sendMessageToAll(boost::str(boost::format(texts[save.success ? "saved" : "failed"].String()) % save.name));
+}
+
 void CGameHandler::close()
 {
 	logGlobal->info("We have been requested to close.");
@@ -4675,10 +4730,12 @@ void CGameHandler::handleDamageFromObstacle(const CObstacleInstance &obstacle, c
 
 void CGameHandler::handleTimeEvents()
 {
-	gs->map->events.sort(evntCmp);
-	while(gs->map->events.size() && gs->map->events.front().firstOccurence+1 == gs->day)
+	//events of game state are changed only by UpdateMapEvents, so savegame journal can replay them
+	std::list<CMapEvent> events = gs->map->events;
+	events.sort(evntCmp);
+	while(events.size() && events.front().firstOccurence+1 == gs->day)
 	{
-		CMapEvent ev = gs->map->events.front();
+		CMapEvent ev = events.front();
 
 		for (int player = 0; player < PlayerColor::PLAYER_LIMIT_I; player++)
 		{
@@ -4713,33 +4770,34 @@ void CGameHandler::handleTimeEvents()
 
 		if (ev.nextOccurence)
 		{
-			gs->map->events.pop_front();
+			events.pop_front();
 
 			ev.firstOccurence += ev.nextOccurence;
-			auto it = gs->map->events.begin();
-			while(it != gs->map->events.end() && it->earlierThanOrEqual(ev))
+			auto it = events.begin();
+			while(it != events.end() && it->earlierThanOrEqual(ev))
 				it++;
-			gs->map->events.insert(it, ev);
+			events.insert(it, ev);
 		}
 		else
 		{
-			gs->map->events.pop_front();
+			events.pop_front();
 		}
 	}
 
 	//TODO send only if changed
 	UpdateMapEvents ume;
-	ume.events = gs->map->events;
+	ume.events = events;
 	sendAndApply(&ume);
 }
 
 void CGameHandler::handleTownEvents(CGTownInstance * town, NewTurn &n)
 {
-	town->events.sort(evntCmp);
-	while(town->events.size() && town->events.front().firstOccurence == gs->day)
+	std::list<CCastleEvent> events = town->events;
+	events.sort(evntCmp);
+	while(events.size() && events.front().firstOccurence == gs->day)
 	{
 		PlayerColor player = town->tempOwner;
-		CCastleEvent ev = town->events.front();
+		CCastleEvent ev = events.front();
 		const PlayerState * pinfo = getPlayer(player, false);
 
 		if (pinfo  //player exists
@@ -4796,24 +4854,24 @@ void CGameHandler::handleTownEvents(CGTownInstance * town, NewTurn &n)
 
 		if (ev.nextOccurence)
 		{
-			town->events.pop_front();
+			events.pop_front();
 
 			ev.firstOccurence += ev.nextOccurence;
-			auto it = town->events.begin();
-			while(it != town->events.end() && it->earlierThanOrEqual(ev))
+			auto it = events.begin();
+			while(it != events.end() && it->earlierThanOrEqual(ev))
 				it++;
-			town->events.insert(it, ev);
+			events.insert(it, ev);
 		}
 		else
 		{
-			town->events.pop_front();
+			events.pop_front();
 		}
 	}
 
 	//TODO send only if changed
 	UpdateCastleEvents uce;
 	uce.town = town->id;
-	uce.events = town->events;
+	uce.events = events;
 	sendAndApply(&uce);
 }
 
@@ -6163,12 +6221,18 @@ void CGameHandler::handleCheatCode(std::string & cheat, PlayerColor player, cons
 	else if (cheat == "vcmisilmaril")
 	{
 		///Player wins
-		gs->getPlayer(player)->enteredWinningCheatCode = 1;
+		PlayerCheated pc;
+		pc.player = player;
+		pc.winningCheatCode = true;
+		sendAndApply(&pc);
 	}
 	else if (cheat == "vcmimelkor")
 	{
 		///Player looses
-		gs->getPlayer(player)->enteredLosingCheatCode = 1;
+		PlayerCheated pc;
+		pc.player = player;
+		pc.losingCheatCode = true;
+		sendAndApply(&pc);
 	}
 	else if (cheat == "vcmieagles" || cheat == "vcmiungoliant")
 	{
@@ -32,6 +32,7 @@ class CGHeroInstance;
 class IMarket;
 
 class ServerSpellCastEnvironment;
+class CFrameSerializer;
 
 struct PlayerStatus
 {
@@ -86,6 +87,8 @@ public:
 	std::map<PlayerColor, CConnection*> connections; //player color -> connection to client with interface of that player
 	PlayerStatuses states; //player color -> player state
 	std::set<CConnection*> conns;
+	std::unique_ptr<CFrameSerializer> broadcastSerializer; //packs for all clients are serialized once
+	boost::mutex broadcastMx; //packs for all clients may be sent from several connection threads
 
 	//queries stuff
 	boost::recursive_mutex gsm;
@@ -288,6 +291,15 @@ public:
 private:
 	ServerSpellCastEnvironment * spellEnv;
 
+	struct FinishedSave
+	{
+		std::string name;
+		bool success;
+	};
+	boost::mutex finishedSavesMx;
+	std::vector<FinishedSave> finishedSaves; //written by background writer, players are told about them by game thread
+	void reportFinishedSaves();
+
 	std::list<PlayerColor> generatePlayerTurnOrder() const;
 	void makeStackDoNothing(const CStack * next);
 	void getVictoryLossMessage(PlayerColor player, const EVictoryLossCheckResult & victoryLossCheckResult, InfoWindow & out) const;
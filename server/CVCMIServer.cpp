@@ -30,6 +30,7 @@
 #include "../lib/logging/CBasicLogConfigurator.h"
 #include "../lib/CConfigHandler.h"
 #include "../lib/ScopeGuard.h"
+#include "../lib/CSimplifiedDuelSimulator.h"
 
 #include "../lib/UnlockGuard.h"
 
@@ -498,7 +499,9 @@ static void handleCommandOptions(int argc, char *argv[])
 		("help,h", "display help and exit")
 		("version,v", "display version information and exit")
 		("port", po::value<int>()->default_value(3030), "port at which server will listen to connections from client")
-		("resultsFile", po::value<std::string>()->default_value("./results.txt"), "file to which the battle result will be appended. Used only in the DUEL mode.");
+		("resultsFile", po::value<std::string>()->default_value("./results.txt"), "file to which the battle result will be appended. Used only in the DUEL mode.")
+		("simplifiedDuels", po::value<std::string>(), "plays duels listed in given JSON file with simplified melee and ranged rules (no spells, morale or AI) in-process on all cores, without clients, then exits")
+		("simplifiedDuelsResults", po::value<std::string>()->default_value("./simplifiedDuelsResults.json"), "file to which statistics of simplified duels will be written");
 
 	if(argc > 1)
 	{
@@ -534,6 +537,28 @@ static void handleCommandOptions(int argc, char *argv[])
 	}
 }
 
+static void runSimplifiedDuels()
+{
+	const auto configFile = cmdLineOptions["simplifiedDuels"].as<std::string>();
+	std::ifstream in(configFile, std::ios::binary);
+	if(!in)
+	{
+		logGlobal->error("Cannot open %s", configFile);
+		return;
+	}
+	const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	CSimplifiedDuelSimulator simulator(JsonNode(data.c_str(), data.size()));
+	simulator.run();
+
+	const auto resultsFile = cmdLineOptions["simplifiedDuelsResults"].as<std::string>();
+	std::ofstream out(resultsFile);
+	if(out)
+		out << simulator.getResults();
+	else
+		logGlobal->error("Cannot open to write %s", resultsFile);
+}
+
 #if defined(__GNUC__) && !defined (__MINGW32__) && !defined(VCMI_ANDROID)
 void handleLinuxSignal(int sig)
 {
@@ -585,6 +610,15 @@ int main(int argc, char** argv)
 
 	loadDLLClasses();
 	srand ( (ui32)time(nullptr) );
+	if(cmdLineOptions.count("simplifiedDuels"))
+	{
+		//no network, server doesn't even listen
+		runSimplifiedDuels();
+		delete VLC;
+		VLC = nullptr;
+		CResourceHandler::clear();
+		return 0;
+	}
 	try
 	{
 		boost::asio::io_service io_service;
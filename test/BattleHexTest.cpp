@@ -0,0 +1,66 @@
+/*
+ * BattleHexTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/BattleHex.h"
+
+namespace
+{
+	/// Distance as computed before it was precomputed
+	int referenceDistance(BattleHex hex1, BattleHex hex2)
+	{
+		int y1 = hex1.getY(),
+			y2 = hex2.getY();
+
+		int x1 = (int)(hex1.getX() + y1 * 0.5),
+			x2 = (int)(hex2.getX() + y2 * 0.5);
+
+		int xDst = x2 - x1,
+			yDst = y2 - y1;
+
+		if ((xDst >= 0 && yDst >= 0) || (xDst < 0 && yDst < 0))
+			return std::max(std::abs(xDst), std::abs(yDst));
+
+		return std::abs(xDst) + std::abs(yDst);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BattleHex_NeighboursMatchCalculated)
+{
+	for(si16 hex = 0; hex < GameConstants::BFIELD_SIZE; hex++)
+	{
+		const auto expected = BattleHex(hex).neighbouringTiles();
+		const auto & view = BattleHex(hex).neighbouringTilesView();
+		BOOST_REQUIRE_EQUAL(view.size(), expected.size());
+		BOOST_CHECK(std::equal(expected.begin(), expected.end(), view.begin()));
+	}
+
+	BOOST_CHECK(BattleHex(BattleHex::INVALID).neighbouringTilesView().empty());
+	BOOST_CHECK(BattleHex(GameConstants::BFIELD_SIZE).neighbouringTilesView().empty());
+}
+
+BOOST_AUTO_TEST_CASE(BattleHex_DistancesMatchCalculated)
+{
+	int mismatches = 0;
+	for(si16 hex1 = 0; hex1 < GameConstants::BFIELD_SIZE; hex1++)
+	{
+		for(si16 hex2 = 0; hex2 < GameConstants::BFIELD_SIZE; hex2++)
+		{
+			if(BattleHex::getDistance(hex1, hex2) != referenceDistance(hex1, hex2))
+				mismatches++;
+		}
+	}
+	BOOST_CHECK_EQUAL(mismatches, 0);
+
+	//turrets are outside of the table
+	BOOST_CHECK_EQUAL(BattleHex::getDistance(-2, 50), referenceDistance(-2, 50));
+}
@@ -0,0 +1,129 @@
+/*
+ * CBattleReachabilityTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/BattleState.h"
+#include "../lib/CGameState.h"
+#include "../lib/CObstacleInstance.h"
+#include "../lib/NetPacks.h"
+#include "../lib/mapObjects/CArmedInstance.h"
+
+namespace
+{
+	/// Battle without heroes or map, changed only by packs like on client
+	struct CBattleReachabilityFixture
+	{
+		CArmedInstance armies[2];
+		CGameState gs;
+		BattleInfo * battle;
+
+		CBattleReachabilityFixture()
+		{
+			battle = new BattleInfo();
+			battle->battlefieldType = BFieldType::GRASS_HILLS;
+			battle->terrainType = ETerrainType::GRASS;
+			battle->round = 1;
+			for(int i = 0; i < 2; i++)
+			{
+				armies[i].tempOwner = PlayerColor(i);
+				battle->sides[i].color = PlayerColor(i);
+				battle->sides[i].init(nullptr, &armies[i]);
+			}
+			battle->localInit();
+			gs.curB = battle;
+		}
+
+		const CStack * addStack(bool attacker, BattleHex pos)
+		{
+			BattleStackAdded bsa;
+			bsa.attacker = attacker;
+			bsa.creID = CreatureID(0); //pikeman, walking and single hex
+			bsa.amount = 10;
+			bsa.pos = pos;
+			gs.apply(&bsa);
+			return battle->battleGetStackByID(bsa.newStackID);
+		}
+	};
+
+	const BattleHex STACK_POS(3, 3);
+	const BattleHex BLOCKER_POS(9, 3);
+	const BattleHex FREE_POS(9, 7);
+}
+
+BOOST_FIXTURE_TEST_CASE(CBattleReachability_StackMoved, CBattleReachabilityFixture)
+{
+	const CStack * stack = addStack(true, STACK_POS);
+	const CStack * blocker = addStack(false, BLOCKER_POS);
+	BOOST_REQUIRE(stack && blocker);
+
+	//fills the cache
+	BOOST_CHECK(battle->getAccesibility()[BLOCKER_POS] == EAccessibility::ALIVE_STACK);
+	BOOST_CHECK(!battle->getReachability(stack).isReachable(BLOCKER_POS));
+	BOOST_CHECK(battle->getReachability(stack).isReachable(FREE_POS));
+
+	BattleStackMoved bsm;
+	bsm.stack = blocker->ID;
+	bsm.tilesToMove.push_back(FREE_POS);
+	gs.apply(&bsm);
+
+	BOOST_CHECK(battle->getAccesibility()[BLOCKER_POS] == EAccessibility::ACCESSIBLE);
+	BOOST_CHECK(battle->getAccesibility()[FREE_POS] == EAccessibility::ALIVE_STACK);
+	BOOST_CHECK(battle->getReachability(stack).isReachable(BLOCKER_POS));
+	BOOST_CHECK(!battle->getReachability(stack).isReachable(FREE_POS));
+
+	//reachability of the moved stack starts at its new position
+	BOOST_CHECK_EQUAL(battle->getReachability(blocker).params.startPosition, FREE_POS);
+	BOOST_CHECK_EQUAL(battle->battleGetDistances(blocker)[FREE_POS], 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CBattleReachability_StacksRemoved, CBattleReachabilityFixture)
+{
+	const CStack * stack = addStack(true, STACK_POS);
+	const CStack * blocker = addStack(false, BLOCKER_POS);
+	BOOST_REQUIRE(stack && blocker);
+
+	BOOST_CHECK(battle->getAccesibility()[BLOCKER_POS] == EAccessibility::ALIVE_STACK);
+	BOOST_CHECK(!battle->getReachability(stack).isReachable(BLOCKER_POS));
+	BOOST_CHECK(!vstd::contains(battle->battleGetAvailableHexes(stack, false), BLOCKER_POS));
+
+	BattleStacksRemoved bsr;
+	bsr.stackIDs.insert(blocker->ID);
+	gs.apply(&bsr);
+
+	BOOST_CHECK(battle->getAccesibility()[BLOCKER_POS] == EAccessibility::ACCESSIBLE);
+	BOOST_CHECK(battle->getReachability(stack).isReachable(BLOCKER_POS));
+}
+
+BOOST_FIXTURE_TEST_CASE(CBattleReachability_ObstaclePlaced, CBattleReachabilityFixture)
+{
+	const CStack * stack = addStack(true, STACK_POS);
+	BOOST_REQUIRE(stack);
+
+	BOOST_CHECK(battle->getAccesibility()[FREE_POS] == EAccessibility::ACCESSIBLE);
+	BOOST_CHECK(battle->getReachability(stack).isReachable(FREE_POS));
+
+	auto obstacle = std::make_shared<SpellCreatedObstacle>();
+	obstacle->obstacleType = CObstacleInstance::FORCE_FIELD;
+	obstacle->pos = FREE_POS;
+	obstacle->uniqueID = 0;
+	obstacle->spellLevel = 0;
+	obstacle->casterSide = 0;
+	obstacle->visibleForAnotherSide = true;
+	obstacle->turnsRemaining = 2;
+
+	BattleObstaclePlaced bop;
+	bop.obstacle = obstacle;
+	gs.apply(&bop);
+
+	BOOST_CHECK(battle->getAccesibility()[FREE_POS] == EAccessibility::OBSTACLE);
+	BOOST_CHECK(!battle->getReachability(stack).isReachable(FREE_POS));
+}
@@ -0,0 +1,72 @@
+
+/*
+ * CBonusListTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/HeroBonus.h"
+
+namespace
+{
+	/// Bonuses of interleaved types, ID is position in the list
+	BonusList makeList()
+	{
+		const Bonus::BonusType types[] = {Bonus::MORALE, Bonus::LUCK, Bonus::MORALE, Bonus::PRIMARY_SKILL, Bonus::LUCK, Bonus::MORALE};
+		BonusList ret;
+		for(ui32 i = 0; i < boost::size(types); i++)
+			ret.push_back(std::make_shared<Bonus>(Bonus::PERMANENT, types[i], Bonus::OTHER, 1, i));
+		return ret;
+	}
+
+	std::vector<ui32> ids(const BonusList & list)
+	{
+		std::vector<ui32> ret;
+		for(auto & b : list)
+			ret.push_back(b->sid);
+		return ret;
+	}
+
+	std::vector<ui32> select(const BonusList & list, const CSelector & selector)
+	{
+		BonusList out;
+		list.getBonuses(out, selector, nullptr);
+		return ids(out);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CBonusList_GroupedKeepsOrder)
+{
+	const BonusList plain = makeList();
+	BonusList grouped = makeList();
+	grouped.groupByType();
+	BOOST_REQUIRE(grouped.isGroupedByType());
+
+	BOOST_CHECK(ids(grouped) == ids(plain));
+
+	const CSelector selectors[] =
+	{
+		Selector::type(Bonus::MORALE),
+		Selector::type(Bonus::LUCK).Or(Selector::type(Bonus::MORALE)),
+		Selector::sourceType(Bonus::OTHER),
+		Selector::type(Bonus::FLYING)
+	};
+	for(auto & selector : selectors)
+	{
+		BOOST_CHECK(select(grouped, selector) == select(plain, selector));
+
+		auto first = grouped.getFirst(selector);
+		auto expected = plain.getFirst(selector);
+		BOOST_CHECK_EQUAL(first ? first->sid : -1, expected ? expected->sid : -1);
+	}
+
+	grouped.push_back(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::LUCK, Bonus::OTHER, 1, 6));
+	BOOST_CHECK(!grouped.isGroupedByType());
+}
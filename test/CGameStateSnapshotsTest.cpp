@@ -0,0 +1,256 @@
+/*
+ * CGameStateSnapshotsTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/CGameState.h"
+#include "../lib/IGameCallback.h"
+#include "../lib/NetPacks.h"
+#include "../lib/StartInfo.h"
+#include "../lib/mapping/CMap.h"
+#include "../lib/mapObjects/MiscObjects.h"
+#include "../lib/rmg/CMapGenOptions.h"
+#include "../lib/serializer/BinaryDeserializer.h"
+#include "../lib/serializer/BinarySerializer.h"
+#include "../lib/serializer/CGameStateSnapshots.h"
+#include "../lib/VCMIDirs.h"
+
+namespace
+{
+	/// Gives access to savegame functions of callback, owns its game state
+	class CSnapshotTestCallback : public CPrivilagedInfoCallback
+	{
+	public:
+		explicit CSnapshotTestCallback(CGameState * GS = nullptr)
+		{
+			gs = GS;
+		}
+		~CSnapshotTestCallback()
+		{
+			delete gs;
+		}
+
+		void save(const boost::filesystem::path & path)
+		{
+			saveFinished(path, startSave(path));
+		}
+
+		/// Writes savegame without reporting it as finished, like when it's still queued for background writer
+		ui32 startSave(const boost::filesystem::path & path)
+		{
+			CSaveFile save(path);
+			return saveCommonState(save);
+		}
+
+		void load(const boost::filesystem::path & path)
+		{
+			CLoadFile load(path, MINIMAL_SERIALIZATION_VERSION);
+			loadCommonState(load);
+		}
+	};
+
+	/// Parts of game state changed by the test
+	struct SStateSummary
+	{
+		size_t objectsCount;
+		std::vector<std::pair<int, int>> monsters; //stack count and character of added monsters
+		int nextRandom;
+	};
+
+	SStateSummary summarize(CGameState * gs, const std::vector<ObjectInstanceID> & monsters)
+	{
+		SStateSummary ret;
+		ret.objectsCount = gs->map->objects.size();
+		for(auto id : monsters)
+		{
+			auto monster = dynamic_cast<const CGCreature *>(gs->map->objects.at(id.getNum()).get());
+			BOOST_REQUIRE(monster);
+			ret.monsters.push_back(std::make_pair(monster->getStackCount(SlotID(0)), static_cast<int>(monster->character)));
+		}
+		ret.nextRandom = gs->getRandomGenerator().nextInt();
+		return ret;
+	}
+
+	CGameState * newGameState()
+	{
+		StartInfo si;
+		si.mode = StartInfo::NEW_GAME;
+		si.seedToBeUsed = 1337;
+		si.mapGenOptions = std::make_shared<CMapGenOptions>();
+		si.mapGenOptions->setHeight(CMapHeader::MAP_SIZE_SMALL);
+		si.mapGenOptions->setWidth(CMapHeader::MAP_SIZE_SMALL);
+		si.mapGenOptions->setHasTwoLevels(false);
+		si.mapGenOptions->setPlayerCount(2);
+		si.mapGenOptions->setPlayerTypeForStandardPlayer(PlayerColor(0), EPlayerType::HUMAN);
+		si.mapGenOptions->setPlayerTypeForStandardPlayer(PlayerColor(1), EPlayerType::AI);
+
+		auto gs = new CGameState();
+		gs->init(&si);
+		return gs;
+	}
+
+	std::vector<int3> freeTiles(const CMap * map, size_t count)
+	{
+		std::vector<int3> ret;
+		for(int x = 1; x < map->width - 1 && ret.size() < count; x += 3)
+		{
+			for(int y = 1; y < map->height - 1 && ret.size() < count; y += 3)
+			{
+				const int3 pos(x, y, 0);
+				const TerrainTile & tile = map->getTile(pos);
+				if(tile.terType != ETerrainType::WATER && tile.terType != ETerrainType::ROCK && !tile.blocked && !tile.visitable)
+					ret.push_back(pos);
+			}
+		}
+		return ret;
+	}
+
+	/// Changes game state by adding a monster, its size is drawn from the generator
+	void addMonster(CGameState * gs, std::vector<ObjectInstanceID> & monsters)
+	{
+		const auto tiles = freeTiles(gs->map, monsters.size() + 1);
+		BOOST_REQUIRE_EQUAL(tiles.size(), monsters.size() + 1);
+		NewObject no;
+		no.ID = Obj::MONSTER;
+		no.subID = 0;
+		no.pos = tiles.back();
+		gs->apply(&no);
+		monsters.push_back(no.id);
+	}
+
+	void checkLoadedEqual(const boost::filesystem::path & first, const boost::filesystem::path & second, const std::vector<ObjectInstanceID> & monsters)
+	{
+		SStateSummary fromFirst, fromSecond;
+		{
+			CSnapshotTestCallback cb;
+			cb.load(first);
+			fromFirst = summarize(cb.gameState(), monsters);
+		}
+		{
+			CSnapshotTestCallback cb;
+			cb.load(second);
+			fromSecond = summarize(cb.gameState(), monsters);
+		}
+
+		BOOST_CHECK_EQUAL(fromFirst.objectsCount, fromSecond.objectsCount);
+		BOOST_CHECK(fromFirst.monsters == fromSecond.monsters);
+		BOOST_CHECK_EQUAL(fromFirst.nextRandom, fromSecond.nextRandom);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CGameStateSnapshots_DeltaLoadsLikeFull)
+{
+	logGlobal->info("CGameStateSnapshots_DeltaLoadsLikeFull start");
+	const auto directory = VCMIDirs::get().userCachePath() / "test_snapshots";
+	const auto deltaPath = directory / "delta" / "Test.vsgm1";
+	const auto fullPath = directory / "full" / "Test.vsgm1";
+	boost::filesystem::remove_all(directory);
+	boost::filesystem::create_directories(deltaPath.parent_path());
+	boost::filesystem::create_directories(fullPath.parent_path());
+
+	std::vector<ObjectInstanceID> monsters;
+	{
+		auto gs = newGameState();
+		CSnapshotTestCallback cb(gs);
+		cb.save(deltaPath); //first savegame is full and becomes the snapshot
+
+		//monsters draw their size from the generator, which is also used between packs
+		for(int i = 0; i < 3; i++)
+		{
+			gs->getRandomGenerator().nextInt();
+			addMonster(gs, monsters);
+		}
+		gs->getRandomGenerator().nextInt();
+
+		cb.save(deltaPath);
+		BOOST_CHECK(!CGameStateSnapshots::getSnapshotName(deltaPath).empty());
+		cb.save(fullPath); //snapshot is in other directory, savegame is full
+		BOOST_CHECK(CGameStateSnapshots::getSnapshotName(fullPath).empty());
+	}
+
+	checkLoadedEqual(deltaPath, fullPath, monsters);
+	boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(CGameStateSnapshots_BackToBackFullSaves)
+{
+	logGlobal->info("CGameStateSnapshots_BackToBackFullSaves start");
+	const auto directory = VCMIDirs::get().userCachePath() / "test_snapshots";
+	const auto firstPath = directory / "delta" / "First.vsgm1";
+	const auto secondPath = directory / "delta" / "Second.vsgm1";
+	const auto deltaPath = directory / "delta" / "Test.vsgm1";
+	const auto fullPath = directory / "full" / "Test.vsgm1";
+	boost::filesystem::remove_all(directory);
+	boost::filesystem::create_directories(deltaPath.parent_path());
+	boost::filesystem::create_directories(fullPath.parent_path());
+
+	std::vector<ObjectInstanceID> monsters;
+	{
+		auto gs = newGameState();
+		CSnapshotTestCallback cb(gs);
+
+		//second full savegame is started before the writer finishes the first one
+		const ui32 firstId = cb.startSave(firstPath);
+		addMonster(gs, monsters);
+		const ui32 secondId = cb.startSave(secondPath);
+		addMonster(gs, monsters);
+
+		//journal is recorded since the second savegame, the first one must not become the snapshot
+		cb.saveFinished(firstPath, firstId);
+		cb.saveFinished(secondPath, secondId);
+		addMonster(gs, monsters);
+
+		cb.save(deltaPath);
+		BOOST_CHECK(!CGameStateSnapshots::getSnapshotName(deltaPath).empty());
+		cb.save(fullPath);
+		BOOST_CHECK(CGameStateSnapshots::getSnapshotName(fullPath).empty());
+	}
+
+	checkLoadedEqual(deltaPath, fullPath, monsters);
+	boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(CGameStateSnapshots_SavesAlternatingWithSubdirectory)
+{
+	logGlobal->info("CGameStateSnapshots_SavesAlternatingWithSubdirectory start");
+	const auto directory = VCMIDirs::get().userCachePath() / "test_snapshots";
+	const auto savePath = directory / "Saves" / "Test.vsgm1";
+	const auto autosavePath = directory / "Saves" / "Autosave" / "Test.vsgm1";
+	const auto fullPath = directory / "full" / "Test.vsgm1";
+	boost::filesystem::remove_all(directory);
+	boost::filesystem::create_directories(autosavePath.parent_path());
+	boost::filesystem::create_directories(fullPath.parent_path());
+
+	std::vector<ObjectInstanceID> monsters;
+	{
+		auto gs = newGameState();
+		CSnapshotTestCallback cb(gs);
+		cb.save(savePath);
+
+		//savegames in the subdirectory refer to the snapshot of the parent directory
+		for(int i = 0; i < 2; i++)
+		{
+			addMonster(gs, monsters);
+			cb.save(autosavePath);
+			BOOST_CHECK(!CGameStateSnapshots::getSnapshotName(autosavePath).empty());
+			addMonster(gs, monsters);
+			cb.save(savePath);
+			BOOST_CHECK(!CGameStateSnapshots::getSnapshotName(savePath).empty());
+		}
+		addMonster(gs, monsters);
+		cb.save(autosavePath);
+		cb.save(fullPath);
+		BOOST_CHECK(CGameStateSnapshots::getSnapshotName(fullPath).empty());
+	}
+
+	checkLoadedEqual(autosavePath, fullPath, monsters);
+	boost::filesystem::remove_all(directory);
+}
@@ -0,0 +1,188 @@
+
+/*
+ * CPathNodeQueueTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/heap/priority_queue.hpp>
+
+#include "../lib/CPathfinder.h"
+#include "../lib/CRandomGenerator.h"
+#include "../lib/CStopWatch.h"
+
+namespace
+{
+	/// Queue pathfinder used before, kept to compare against
+	struct LegacyNodeComparer
+	{
+		bool operator()(const CGPathNode * lhs, const CGPathNode * rhs) const
+		{
+			if(rhs->turns > lhs->turns)
+				return false;
+			else if(rhs->turns == lhs->turns && rhs->moveRemains < lhs->moveRemains)
+				return false;
+
+			return true;
+		}
+	};
+	typedef boost::heap::priority_queue<CGPathNode *, boost::heap::compare<LegacyNodeComparer> > TLegacyQueue;
+
+	const int MAX_MOVE_POINTS = 1500;
+
+	/// Simplified pathfinder main loop on a map with random terrain costs, returns number of expanded nodes
+	template<typename Queue>
+	int runSearch(CPathsInfo & paths, const std::vector<int> & tileCosts)
+	{
+		Queue pq;
+		paths.newEpoch();
+
+		CGPathNode * initialNode = paths.getNode(int3(0, 0, 0), EPathfindingLayer::LAND);
+		initialNode->turns = 0;
+		initialNode->moveRemains = MAX_MOVE_POINTS;
+		pq.push(initialNode);
+
+		int expanded = 0;
+		while(!pq.empty())
+		{
+			CGPathNode * cp = pq.top();
+			pq.pop();
+			cp->locked = true;
+			expanded++;
+
+			int movement = cp->moveRemains, turn = cp->turns;
+			if(!movement)
+			{
+				turn++;
+				movement = MAX_MOVE_POINTS;
+			}
+
+			for(int dx = -1; dx <= 1; dx++)
+			{
+				for(int dy = -1; dy <= 1; dy++)
+				{
+					int3 pos = cp->coord + int3(dx, dy, 0);
+					if((!dx && !dy) || pos.x < 0 || pos.y < 0 || pos.x >= paths.sizes.x || pos.y >= paths.sizes.y)
+						continue;
+
+					CGPathNode * dp = paths.getNode(pos, EPathfindingLayer::LAND);
+					if(dp->locked)
+						continue;
+
+					int cost = tileCosts[pos.x * paths.sizes.y + pos.y];
+					if(dx && dy)
+						cost = cost * 141 / 100;
+
+					int turnAtNextTile = turn, remains = movement - cost;
+					if(remains < 0)
+					{
+						turnAtNextTile++;
+						remains = MAX_MOVE_POINTS - cost;
+					}
+
+					if(dp->turns > turnAtNextTile || (dp->turns == turnAtNextTile && dp->moveRemains < remains))
+					{
+						dp->turns = turnAtNextTile;
+						dp->moveRemains = remains;
+						dp->theNodeBefore = paths.getNodeIndex(cp);
+						pq.push(dp);
+					}
+				}
+			}
+		}
+		return expanded;
+	}
+
+	std::vector<int> randomTileCosts(const int3 & sizes)
+	{
+		//roads, normal terrain and rough terrain, like on adventure map
+		static const int COSTS[] = {50, 75, 100, 100, 100, 125, 150, 175};
+		CRandomGenerator rand;
+		rand.setSeed(42);
+		std::vector<int> ret(sizes.x * sizes.y);
+		for(auto & cost : ret)
+			cost = COSTS[rand.nextInt(7)];
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CPathNodeQueue_Order)
+{
+	CPathsInfo paths(int3(16, 16, 1));
+	CRandomGenerator rand;
+	rand.setSeed(1337);
+
+	CPathNodeQueue queue;
+	std::vector<CGPathNode *> nodes;
+	for(int i = 0; i < 200; i++)
+	{
+		CGPathNode * node = paths.getNode(int3(i % 16, i / 16, 0), EPathfindingLayer::LAND);
+		node->turns = rand.nextInt(3);
+		node->moveRemains = rand.nextInt(2000);
+		queue.push(node);
+		nodes.push_back(node);
+	}
+
+	//improving queued node must not add it again
+	for(int i = 0; i < 200; i += 3)
+	{
+		nodes[i]->turns = 0;
+		nodes[i]->moveRemains += 1;
+		queue.push(nodes[i]);
+	}
+	BOOST_CHECK_EQUAL(queue.size(), 200);
+
+	const CGPathNode * previous = nullptr;
+	while(!queue.empty())
+	{
+		const CGPathNode * node = queue.top();
+		queue.pop();
+		if(previous)
+		{
+			BOOST_CHECK(previous->turns <= node->turns);
+			if(previous->turns == node->turns)
+				BOOST_CHECK(previous->moveRemains >= node->moveRemains);
+		}
+		previous = node;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CPathNodeQueue_Benchmark)
+{
+	//size of XL map, underground is left unused
+	const int3 sizes(144, 144, 2);
+	const auto tileCosts = randomTileCosts(sizes);
+
+	CPathsInfo legacyPaths(sizes);
+	CPathsInfo paths(sizes);
+
+	CStopWatch timer;
+	int legacyExpanded = runSearch<TLegacyQueue>(legacyPaths, tileCosts);
+	si64 legacyTime = timer.getDiff();
+	int expanded = runSearch<CPathNodeQueue>(paths, tileCosts);
+	si64 time = timer.getDiff();
+
+	logGlobal->info("Path node queue: %d expansions in %d ms, previous binary heap: %d expansions in %d ms",
+		expanded, time, legacyExpanded, legacyTime);
+
+	BOOST_CHECK_LE(expanded, legacyExpanded);
+	BOOST_CHECK_EQUAL(expanded, sizes.x * sizes.y);
+
+	int3 pos;
+	for(pos.x = 0; pos.x < sizes.x; pos.x++)
+	{
+		for(pos.y = 0; pos.y < sizes.y; pos.y++)
+		{
+			const CGPathNode * lhs = paths.getNode(pos, EPathfindingLayer::LAND);
+			const CGPathNode * rhs = legacyPaths.getNode(pos, EPathfindingLayer::LAND);
+			BOOST_CHECK_EQUAL(lhs->turns, rhs->turns);
+			BOOST_CHECK_EQUAL(lhs->moveRemains, rhs->moveRemains);
+		}
+	}
+}
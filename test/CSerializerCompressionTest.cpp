@@ -0,0 +1,96 @@
+/*
+ * CSerializerCompressionTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/CCreatureHandler.h"
+#include "../lib/CHeroHandler.h"
+#include "../lib/mapping/CMap.h"
+#include "../lib/rmg/CMapGenOptions.h"
+#include "../lib/rmg/CMapGenerator.h"
+#include "../lib/serializer/BinaryDeserializer.h"
+#include "../lib/serializer/BinarySerializer.h"
+#include "../lib/serializer/Connection.h"
+#include "../lib/CStopWatch.h"
+#include "../lib/VCMIDirs.h"
+
+static std::unique_ptr<CMap> generateMap()
+{
+	CMapGenOptions opt;
+	opt.setHeight(CMapHeader::MAP_SIZE_MIDDLE);
+	opt.setWidth(CMapHeader::MAP_SIZE_MIDDLE);
+	opt.setHasTwoLevels(true);
+	opt.setPlayerCount(2);
+
+	CMapGenerator gen;
+	auto map = gen.generate(&opt, 1337);
+	map->name = "Test";
+	return map;
+}
+
+BOOST_AUTO_TEST_CASE(CSerializerCompression_Benchmark)
+{
+	logGlobal->info("CSerializerCompression_Benchmark start");
+	auto map = generateMap();
+	const CMap * toSave = map.get();
+
+	//savegame path
+	std::map<bool, boost::filesystem::path> paths;
+	paths[false] = VCMIDirs::get().userDataPath() / "test_raw.vsgm1";
+	paths[true] = VCMIDirs::get().userDataPath() / "test_compressed.vsgm1";
+	std::map<bool, ui64> fileSizes;
+	for(auto & path : paths)
+	{
+		CStopWatch timer;
+		{
+			CSaveFile save(path.second, path.first);
+			save << toSave;
+		}
+		si64 saveTime = timer.getDiff();
+
+		CMap * loaded = nullptr;
+		{
+			CLoadFile load(path.second);
+			load >> loaded;
+		}
+		si64 loadTime = timer.getDiff();
+		std::unique_ptr<CMap> loadedMap(loaded);
+
+		fileSizes[path.first] = boost::filesystem::file_size(path.second);
+		logGlobal->info("Savegame %s: %d bytes, saved in %d ms, loaded in %d ms",
+			path.first ? "compressed" : "uncompressed", fileSizes[path.first], saveTime, loadTime);
+
+		BOOST_REQUIRE(loadedMap);
+		BOOST_CHECK_EQUAL(loadedMap->name, map->name);
+		BOOST_CHECK_EQUAL(loadedMap->width, map->width);
+		BOOST_CHECK_EQUAL(loadedMap->height, map->height);
+		BOOST_CHECK_EQUAL(loadedMap->objects.size(), map->objects.size());
+		boost::filesystem::remove(path.second);
+	}
+	BOOST_CHECK_LT(fileSizes[true], fileSizes[false]);
+
+	//network path, same frames as sent during initial synchronization
+	std::map<bool, size_t> frameSizes;
+	for(bool compress : {false, true})
+	{
+		CFrameSerializer serializer;
+		serializer.compressFrames = compress;
+		CStopWatch timer;
+		TFrame frame = serializer.serialize(toSave);
+		si64 time = timer.getDiff();
+
+		frameSizes[compress] = frame->size();
+		logGlobal->info("Network frame %s: %d bytes, serialized in %d ms", compress ? "compressed" : "uncompressed", frame->size(), time);
+	}
+	BOOST_CHECK_LT(frameSizes[true], frameSizes[false]);
+
+	logGlobal->info("CSerializerCompression_Benchmark finish");
+}
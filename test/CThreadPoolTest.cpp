@@ -0,0 +1,110 @@
+/*
+ * CThreadPoolTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../lib/CThreadPool.h"
+
+BOOST_AUTO_TEST_CASE(CThreadPool_ParallelForVisitsEveryIndexOnce)
+{
+	CThreadPool pool(4);
+	const size_t count = 1000;
+	std::vector<std::atomic<int>> visits(count);
+	for(auto & visit : visits)
+		visit = 0;
+
+	pool.parallelFor(0, count, [&](size_t i){ visits[i]++; });
+	for(size_t i = 0; i < count; i++)
+		BOOST_CHECK_EQUAL(visits[i], 1);
+
+	bool called = false;
+	pool.parallelFor(5, 5, [&](size_t){ called = true; });
+	BOOST_CHECK(!called);
+}
+
+BOOST_AUTO_TEST_CASE(CThreadPool_WaitRethrowsTaskError)
+{
+	CThreadPool pool(2);
+	std::atomic<int> finished(0);
+	{
+		CThreadPool::TaskGroup group(pool);
+		for(int i = 0; i < 10; i++)
+		{
+			group.run([&finished, i]()
+			{
+				if(i == 3)
+					throw std::runtime_error("task failed");
+				finished++;
+			});
+		}
+		BOOST_CHECK_THROW(group.wait(), std::runtime_error);
+		BOOST_CHECK_EQUAL(finished, 9); //other tasks still ran
+		BOOST_CHECK_NO_THROW(group.wait()); //error is reported once
+	}
+
+	BOOST_CHECK_THROW(pool.parallelFor(0, 100, [](size_t i)
+	{
+		if(i == 50)
+			throw std::runtime_error("task failed");
+	}), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(CThreadPool_NestedWaits)
+{
+	//single worker, so nested groups finish only if waiting threads execute tasks of their groups
+	CThreadPool pool(1);
+	std::atomic<int> sum(0);
+	CThreadPool::TaskGroup outer(pool);
+	for(int i = 0; i < 8; i++)
+	{
+		outer.run([&pool, &sum]()
+		{
+			CThreadPool::TaskGroup inner(pool);
+			for(int j = 0; j < 8; j++)
+				inner.run([&sum](){ sum++; });
+			inner.wait();
+		});
+	}
+	outer.wait();
+	BOOST_CHECK_EQUAL(sum, 64);
+}
+
+BOOST_AUTO_TEST_CASE(CThreadPool_WaitRunsOnlyOwnTasks)
+{
+	CThreadPool pool(1);
+
+	//keep the only worker busy
+	std::promise<void> release;
+	auto released = release.get_future().share();
+	std::promise<void> started;
+	pool.post([released, &started]()
+	{
+		started.set_value();
+		released.wait();
+	});
+	started.get_future().wait();
+
+	std::atomic<bool> otherRan(false);
+	CThreadPool::TaskGroup other(pool);
+	other.run([&otherRan](){ otherRan = true; });
+
+	boost::thread::id ownRunner;
+	CThreadPool::TaskGroup own(pool);
+	own.run([&ownRunner](){ ownRunner = boost::this_thread::get_id(); });
+	own.wait();
+
+	BOOST_CHECK(ownRunner == boost::this_thread::get_id());
+	BOOST_CHECK(!otherRan);
+
+	release.set_value();
+	other.wait();
+	BOOST_CHECK(otherRan);
+}